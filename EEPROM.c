@@ -13,6 +13,8 @@
 
 
 #include "EEPROM.h"
+#include "EEPROM_crc.h"
+#include <string.h>
 
 // Define various commands for the EEPROM
 #define EEPROM_SPI_ENABLE_WRITE			0x06	///< Write Enable
@@ -22,10 +24,15 @@
 #define EEPROM_SPI_READ_DATA			0x03	///< Read Data from Memory Array
 #define EEPROM_SPI_WRITE_DATA	        0x02	///< Write Data to Memory Array
 
+#define EEPROM_MAX_HEADER_SIZE			4		///< Opcode and up to three address bytes
+
+static EEPROM_Result EEPROM_waitReady(EEPROM_Device* dev);
+
 //---------------------------------------HAL Functions---------------------------------------
-static uint8_t EEPROM_exchangeSpi(SPIDriver *spip, uint16_t frame)
+#if EEPROM_USE_SPC5_HAL == TRUE
+static uint8_t EEPROM_exchangeSpi(EEPROM_Device* dev, uint8_t frame)
 {
-	return (spi_lld_polled_exchange(spip, frame));
+	return (spi_lld_polled_exchange(dev->spip, frame));
 }
 
 void EEPROM_startSpi(SPIDriver* spip, SPIConfig* pConfig)
@@ -38,110 +45,2032 @@ void EEPROM_stopSpi(SPIDriver* spip)
 	spi_lld_stop(spip);
 }
 
-static void EEPROM_setChipSelect(void)
+static void EEPROM_setChipSelect(EEPROM_Device* dev)
+{
+	pal_lld_setpad(dev->csPort, dev->csPad);
+}
+
+static void EEPROM_clearChipSelect(EEPROM_Device* dev)
+{
+	pal_lld_clearpad(dev->csPort, dev->csPad);
+}
+
+static void EEPROM_delayUs(EEPROM_Device* dev, uint32_t us)
+{
+	(void)dev;
+	osalThreadDelayMicroseconds(us);
+}
+
+#if EEPROM_USE_STATISTICS == TRUE
+static uint32_t EEPROM_timeUs(EEPROM_Device* dev)
+{
+	(void)dev;
+	return EEPROM_TIME_US();
+}
+#endif
+
+static const EEPROM_Hal EEPROM_halSpc5 =
+{
+	EEPROM_exchangeSpi,
+	EEPROM_clearChipSelect,
+	EEPROM_setChipSelect,
+	EEPROM_delayUs,
+#if EEPROM_USE_STATISTICS == TRUE
+	EEPROM_timeUs,
+#else
+	NULL,
+#endif
+};
+
+#if EEPROM_USE_HW_CS == TRUE
+// DSPI register fields used by the hardware chip select burst mode
+#define EEPROM_DSPI_PUSHR_CONT		0x80000000UL	///< Keep PCS asserted after the frame
+#define EEPROM_DSPI_PUSHR_CTAS(n)	((uint32_t)(n) << 28)
+#define EEPROM_DSPI_PUSHR_EOQ		0x08000000UL	///< Last frame of the queue
+#define EEPROM_DSPI_PUSHR_PCS(mask)	((uint32_t)(mask) << 16)
+#define EEPROM_DSPI_SR_TCF			0x80000000UL	///< Transfer complete
+#define EEPROM_DSPI_SR_EOQF			0x10000000UL	///< End of queue reached
+#define EEPROM_DSPI_SR_RFDF			0x00020000UL	///< RX FIFO not empty
+#define EEPROM_DSPI_SR_RXCTR(sr)	(((sr) >> 4) & 0x0FUL)	///< Entries in the RX FIFO
+
+/**
+ * @brief Width in bytes of the frame starting at byte @p pos of a burst.
+ */
+static uint32_t EEPROM_frameWidth(bool wide, uint32_t pos, uint32_t total)
+{
+	return (wide && (pos + 1 < total)) ? 2 : 1;
+}
+
+static uint8_t EEPROM_burstByte(const uint8_t* header, uint32_t headerLength, const uint8_t* tx, uint32_t pos)
+{
+	if (pos < headerLength)
+	{
+		return header[pos];
+	}
+	return (tx != NULL) ? tx[pos - headerLength] : 0;
+}
+
+/**
+ * @brief Transfer a whole transaction as one continuous chip select frame sequence.
+ *
+ * Up to EEPROM_DSPI_FIFO_DEPTH frames are kept in flight. With a 16 bit CTAR set in
+ * @p ctas16, pairs of bytes are sent as one frame, most significant byte first, which
+ * gives the same bit sequence on the bus.
+ */
+static void EEPROM_burstTransfer(EEPROM_Device* dev, const uint8_t* header, uint32_t headerLength,
+								 const uint8_t* tx, uint8_t* rx, uint32_t length)
+{
+	SPIDriver* spip = dev->spip;
+	uint32_t command = EEPROM_DSPI_PUSHR_CONT | EEPROM_DSPI_PUSHR_PCS(dev->pcsMask);
+	uint32_t total = headerLength + length;
+	bool wide = (dev->ctas16 != dev->ctas);
+	uint32_t pushed = 0;
+	uint32_t popped = 0;
+	uint32_t inFlight = 0;
+
+	spip->dspi->MCR.B.HALT = 0;
+	while (popped < total)
+	{
+		if ((pushed < total) && (inFlight < EEPROM_DSPI_FIFO_DEPTH))
+		{
+			uint32_t width = EEPROM_frameWidth(wide, pushed, total);
+			uint32_t pushr = command | EEPROM_DSPI_PUSHR_CTAS((width == 2) ? dev->ctas16 : dev->ctas);
+			uint32_t frame = EEPROM_burstByte(header, headerLength, tx, pushed);
+
+			if (width == 2)
+			{
+				frame = (frame << 8) | EEPROM_burstByte(header, headerLength, tx, pushed + 1);
+			}
+			if (pushed + width == total)
+			{
+				// the last frame releases the chip select
+				pushr = (pushr & ~EEPROM_DSPI_PUSHR_CONT) | EEPROM_DSPI_PUSHR_EOQ;
+			}
+
+			spip->dspi->PUSHR.R = pushr | frame;
+			pushed += width;
+			inFlight++;
+			continue;
+		}
+
+		// the FIFOs are full or everything is pushed, collect the oldest frame
+		while (EEPROM_DSPI_SR_RXCTR(spip->dspi->SR.R) == 0)
+		{
+		}
+		uint32_t width = EEPROM_frameWidth(wide, popped, total);
+		uint32_t frame = spip->dspi->POPR.R;
+		spip->dspi->SR.R = EEPROM_DSPI_SR_RFDF | EEPROM_DSPI_SR_TCF;
+		inFlight--;
+
+		for (uint32_t i = 0; i < width; i++, popped++)
+		{
+			if ((rx != NULL) && (popped >= headerLength))
+			{
+				rx[popped - headerLength] = frame >> (8 * (width - 1 - i));
+			}
+		}
+	}
+	spip->dspi->SR.R = EEPROM_DSPI_SR_EOQF;
+	spip->dspi->MCR.B.HALT = 1;
+}
+#endif
+
+#if EEPROM_USE_DMA == TRUE
+/**
+ * @brief Thread waiting for the DMA transfer of one SPI driver.
+ */
+typedef struct
+{
+	SPIDriver* spip;
+	thread_reference_t thread;
+}EEPROM_DmaSlot;
+
+static EEPROM_DmaSlot EEPROM_dmaSlots[EEPROM_DMA_MAX_DRIVERS];
+
+static EEPROM_DmaSlot* EEPROM_findDmaSlot(SPIDriver* spip)
+{
+	for (uint32_t i = 0; i < EEPROM_DMA_MAX_DRIVERS; i++)
+	{
+		if (EEPROM_dmaSlots[i].spip == spip)
+		{
+			return &EEPROM_dmaSlots[i];
+		}
+	}
+	return NULL;
+}
+
+static void EEPROM_claimDmaSlot(SPIDriver* spip)
+{
+	if (EEPROM_findDmaSlot(spip) == NULL)
+	{
+		EEPROM_DmaSlot* slot = EEPROM_findDmaSlot(NULL);
+		if (slot != NULL)
+		{
+			slot->spip = spip;
+		}
+	}
+}
+
+void EEPROM_dmaEndCallback(SPIDriver* spip)
+{
+	EEPROM_DmaSlot* slot = EEPROM_findDmaSlot(spip);
+	if (slot != NULL)
+	{
+		osalSysLockFromISR();
+		osalThreadResumeI(&slot->thread, MSG_OK);
+		osalSysUnlockFromISR();
+	}
+}
+
+// the transfers are started in the locked state, so the end callback cannot run
+// before the thread is suspended
+static void EEPROM_sendDma(EEPROM_DmaSlot* slot, const uint8_t* data, uint32_t length)
+{
+	osalSysLock();
+	spi_lld_send(slot->spip, length, data);
+	(void)osalThreadSuspendS(&slot->thread);
+	osalSysUnlock();
+}
+
+static void EEPROM_receiveDma(EEPROM_DmaSlot* slot, uint8_t* data, uint32_t length)
+{
+	osalSysLock();
+	spi_lld_receive(slot->spip, length, data);
+	(void)osalThreadSuspendS(&slot->thread);
+	osalSysUnlock();
+}
+
+static void EEPROM_exchangeDma(EEPROM_DmaSlot* slot, const uint8_t* tx, uint8_t* rx, uint32_t length)
+{
+	osalSysLock();
+	spi_lld_exchange(slot->spip, length, tx, rx);
+	(void)osalThreadSuspendS(&slot->thread);
+	osalSysUnlock();
+}
+#endif
+#endif
+
+static void EEPROM_lock(EEPROM_Device* dev)
+{
+#if EEPROM_USE_MUTUAL_EXCLUSION == TRUE
+	if (dev->busMutex != NULL)
+	{
+		osalMutexLock(dev->busMutex);
+	}
+#else
+	(void)dev;
+#endif
+}
+
+static void EEPROM_unlock(EEPROM_Device* dev)
+{
+#if EEPROM_USE_MUTUAL_EXCLUSION == TRUE
+	if (dev->busMutex != NULL)
+	{
+		osalMutexUnlock(dev->busMutex);
+	}
+#else
+	(void)dev;
+#endif
+}
+
+#if EEPROM_USE_STATISTICS == TRUE
+#define EEPROM_STATS_ADD(dev, counter, n)	((dev)->stats.counter += (n))
+// the start time of a blocking function, taken before the bus is locked
+#define EEPROM_API_ENTER(dev)				uint32_t apiStart = EEPROM_statsTime(dev)
+#define EEPROM_API_EXIT(dev, api)			EEPROM_noteLatency(dev, api, apiStart)
+
+static uint32_t EEPROM_statsTime(EEPROM_Device* dev)
+{
+	return (dev->hal->timeUs != NULL) ? dev->hal->timeUs(dev) : 0;
+}
+
+/**
+ * @brief Keep the latency of a blocking function, with the bus locked.
+ */
+static void EEPROM_noteLatency(EEPROM_Device* dev, EEPROM_Api api, uint32_t start)
+{
+	uint32_t latency = EEPROM_statsTime(dev) - start;
+
+	if (latency > dev->stats.maxLatencyUs[api])
+	{
+		dev->stats.maxLatencyUs[api] = latency;
+	}
+}
+#else
+#define EEPROM_STATS_ADD(dev, counter, n)
+#define EEPROM_API_ENTER(dev)
+#define EEPROM_API_EXIT(dev, api)
+#endif
+
+static void EEPROM_beginTransaction(EEPROM_Device* dev, uint8_t opcode)
+{
+#if EEPROM_USE_TRACE == TRUE
+	if (dev->traceHook != NULL)
+	{
+		dev->traceHook(dev, TraceEvent_Begin, opcode, 0, dev->traceCtx);
+	}
+#else
+	(void)dev;
+	(void)opcode;
+#endif
+}
+
+static void EEPROM_endTransaction(EEPROM_Device* dev, uint8_t opcode, uint32_t length)
+{
+	EEPROM_STATS_ADD(dev, transactions, 1);
+	EEPROM_STATS_ADD(dev, spiBytes, length);
+	EEPROM_STATS_ADD(dev, wrenCount, (opcode == EEPROM_SPI_ENABLE_WRITE) ? 1 : 0);
+#if EEPROM_USE_TRACE == TRUE
+	if (dev->traceHook != NULL)
+	{
+		dev->traceHook(dev, TraceEvent_End, opcode, length, dev->traceCtx);
+	}
+#else
+	(void)dev;
+	(void)opcode;
+	(void)length;
+#endif
+}
+
+static void EEPROM_transferFrames(EEPROM_Device* dev, const uint8_t* header, uint32_t headerLength,
+								  const uint8_t* tx, uint8_t* rx, uint32_t length)
 {
-	pal_lld_setpad(PORT6, PIN_DSPI_CS_EEPROM);
+#if (EEPROM_USE_SPC5_HAL == TRUE) && (EEPROM_USE_HW_CS == TRUE)
+	if ((dev->hal == &EEPROM_halSpc5) && (dev->pcsMask != 0))
+	{
+		EEPROM_burstTransfer(dev, header, headerLength, tx, rx, length);
+		return;
+	}
+#endif
+
+	dev->hal->select(dev);
+
+#if (EEPROM_USE_SPC5_HAL == TRUE) && (EEPROM_USE_DMA == TRUE)
+	EEPROM_DmaSlot* slot = (dev->hal == &EEPROM_halSpc5) ? EEPROM_findDmaSlot(dev->spip) : NULL;
+	if ((slot != NULL) && (length >= EEPROM_DMA_THRESHOLD))
+	{
+		if ((tx != NULL) && (length <= EEPROM_MAX_PAGE_SIZE))
+		{
+			// header followed by the data, sent as one block
+			uint8_t frame[EEPROM_MAX_HEADER_SIZE + EEPROM_MAX_PAGE_SIZE];
+			memcpy(frame, header, headerLength);
+			memcpy(&frame[headerLength], tx, length);
+			EEPROM_sendDma(slot, frame, headerLength + length);
+		}
+		else if ((tx == NULL) && (length <= EEPROM_DMA_READ_SPAN))
+		{
+			// command and data in one exchange, the data is copied from the bounce buffer
+			uint8_t frame[EEPROM_MAX_HEADER_SIZE + EEPROM_DMA_READ_SPAN];
+			memset(frame, 0, headerLength + length);
+			memcpy(frame, header, headerLength);
+			EEPROM_exchangeDma(slot, frame, frame, headerLength + length);
+			if (rx != NULL)
+			{
+				memcpy(rx, &frame[headerLength], length);
+			}
+		}
+		else
+		{
+			EEPROM_sendDma(slot, header, headerLength);
+			if (tx != NULL)
+			{
+				EEPROM_sendDma(slot, tx, length);
+			}
+			else
+			{
+				EEPROM_receiveDma(slot, rx, length);
+			}
+		}
+		dev->hal->deselect(dev);
+		return;
+	}
+#endif
+
+	for (uint32_t i = 0; i < headerLength; i++)
+	{
+		dev->hal->exchange(dev, header[i]);
+	}
+	for (uint32_t i = 0; i < length; i++)
+	{
+		uint8_t data = dev->hal->exchange(dev, (tx != NULL) ? tx[i] : 0);
+		if (rx != NULL)
+		{
+			rx[i] = data;
+		}
+	}
+
+	dev->hal->deselect(dev);
 }
 
-static void EEPROM_clearChipSelect(void)
+/**
+ * @brief Transfer one transaction framed by the chip select.
+ *
+ * The header bytes are sent first, followed by @p length data bytes that are taken
+ * from @p tx and/or stored to @p rx. Either data pointer may be NULL.
+ */
+static void EEPROM_transfer(EEPROM_Device* dev, const uint8_t* header, uint32_t headerLength,
+							const uint8_t* tx, uint8_t* rx, uint32_t length)
 {
-	pal_lld_clearpad(PORT6, PIN_DSPI_CS_EEPROM);
+	EEPROM_beginTransaction(dev, header[0]);
+	EEPROM_transferFrames(dev, header, headerLength, tx, rx, length);
+	EEPROM_endTransaction(dev, header[0], headerLength + length);
 }
 //-------------------------------------------------------------------------------------------
 
-void EEPROM_enableWrite(SPIDriver* spip)
+void EEPROM_initDevice(EEPROM_Device* dev, SPIDriver* spip, ioportid_t csPort, uint8_t csPad, EEPROM_Part part)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_ENABLE_WRITE);
-	EEPROM_setChipSelect();
+	memset(dev, 0, sizeof(*dev));
+
+	dev->spip = spip;
+	dev->csPort = csPort;
+	dev->csPad = csPad;
+
+	switch (part)
+	{
+	case Part_M95040:
+		dev->pageSize = 16;
+		dev->capacity = 512;
+		dev->addressFormat = AddressFormat_OneByteA8;
+		break;
+
+	case Part_AT25320A:
+	default:
+		dev->pageSize = 32;
+		dev->capacity = 4096;
+		dev->addressFormat = AddressFormat_TwoByte;
+		break;
+	}
+
+	dev->waitPolicy.initialDelayUs = EEPROM_WAIT_INITIAL_US;
+	dev->waitPolicy.minPollUs = EEPROM_WAIT_MIN_POLL_US;
+	dev->waitPolicy.maxPollUs = EEPROM_WAIT_MAX_POLL_US;
+	dev->waitPolicy.timeoutUs = EEPROM_WAIT_TIMEOUT_US;
+	dev->waitPolicy.continuousRead = false;
+	dev->readvGap = EEPROM_READV_GAP;
+	dev->verifyRetries = EEPROM_VERIFY_RETRIES;
+
+#if EEPROM_USE_SPC5_HAL == TRUE
+	EEPROM_setHal(dev, &EEPROM_halSpc5, NULL);
+#if EEPROM_USE_DMA == TRUE
+	EEPROM_claimDmaSlot(spip);
+#endif
+#endif
 }
 
-void EEPROM_disableWrite(SPIDriver* spip)
+#if EEPROM_USE_MUTUAL_EXCLUSION == TRUE
+void EEPROM_setBusMutex(EEPROM_Device* dev, mutex_t* mutex)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_DISABLE_WRITE);
-	EEPROM_setChipSelect();
+	dev->busMutex = mutex;
 }
+#endif
 
-uint8_t EEPROM_readStatusReg(SPIDriver* spip)
+void EEPROM_setHal(EEPROM_Device* dev, const EEPROM_Hal* hal, void* ctx)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_READ_STATUS_REG);
-	uint8_t retVal = EEPROM_exchangeSpi(spip, 0);
-	EEPROM_setChipSelect();
-	return retVal;
+	dev->hal = hal;
+	dev->halCtx = ctx;
+	dev->hal->deselect(dev);
+}
+
+/**
+ * @brief Build the opcode and address bytes of a memory access.
+ *
+ * @return The number of header bytes.
+ */
+static uint32_t EEPROM_buildHeader(EEPROM_Device* dev, uint8_t opcode, uint32_t addr, uint8_t* header)
+{
+	switch (dev->addressFormat)
+	{
+	case AddressFormat_OneByteA8:
+		header[0] = opcode | ((addr >> 5) & 0x08);
+		header[1] = (addr & 0xFF);
+		return 2;
+
+	case AddressFormat_ThreeByte:
+		header[0] = opcode;
+		header[1] = (addr >> 16) & 0xFF;
+		header[2] = (addr >> 8) & 0xFF;
+		header[3] = (addr & 0xFF);
+		return 4;
+
+	case AddressFormat_TwoByte:
+	default:
+		header[0] = opcode;
+		header[1] = (addr >> 8) & 0xFF;
+		header[2] = (addr & 0xFF);
+		return 3;
+	}
+}
+
+static void EEPROM_readDevice(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	uint8_t header[EEPROM_MAX_HEADER_SIZE];
+	uint32_t headerLength = EEPROM_buildHeader(dev, EEPROM_SPI_READ_DATA, startAddr, header);
+
+	EEPROM_transfer(dev, header, headerLength, NULL, data, length);
+}
+
+/**
+ * @brief Check whether a read of @p length bytes bypasses the byte loop of the HAL.
+ */
+static bool EEPROM_usesBlockTransfer(EEPROM_Device* dev, uint32_t length)
+{
+	bool block = false;
+
+#if EEPROM_USE_SPC5_HAL == TRUE
+	if (dev->hal == &EEPROM_halSpc5)
+	{
+#if EEPROM_USE_HW_CS == TRUE
+		block = (dev->pcsMask != 0);
+#endif
+#if EEPROM_USE_DMA == TRUE
+		block = block || ((length >= EEPROM_DMA_THRESHOLD) && (EEPROM_findDmaSlot(dev->spip) != NULL));
+#endif
+	}
+#endif
+	(void)dev;
+	(void)length;
+	return block;
+}
+
+static void EEPROM_writePage(EEPROM_Device* dev, uint32_t startAddr, const uint8_t* data, uint32_t length)
+{
+	uint8_t header[EEPROM_MAX_HEADER_SIZE];
+	uint32_t headerLength = EEPROM_buildHeader(dev, EEPROM_SPI_WRITE_DATA, startAddr, header);
+
+	EEPROM_transfer(dev, header, headerLength, data, NULL, length);
+	EEPROM_STATS_ADD(dev, pagesWritten, 1);
+	// the write cycle resets the latch
+	dev->busy = true;
+	dev->writeEnabled = false;
+
+	// kept to answer reads during the write cycle and to verify the page
+	if (data != dev->pending)
+	{
+		memcpy(dev->pending, data, length);
+	}
+	dev->pendingAddr = startAddr;
+	dev->pendingLength = length;
+	dev->verifyPending = (dev->verifyMode != VerifyMode_None);
+	dev->verifyAttempts = 0;
+	if (dev->verifyMode == VerifyMode_Crc)
+	{
+		dev->pendingCrc = EEPROM_crc16(EEPROM_CRC16_INIT, data, length);
+	}
+}
+
+/**
+ * @brief Answer a read from the data of the page write in progress.
+ *
+ * @return true if the range lies within the page write and the data was copied.
+ */
+static bool EEPROM_readPending(EEPROM_Device* dev, uint32_t addr, uint8_t* data, uint32_t length)
+{
+	if (!dev->busy || (addr < dev->pendingAddr) || (addr + length > dev->pendingAddr + dev->pendingLength))
+	{
+		return false;
+	}
+
+	memcpy(data, &dev->pending[addr - dev->pendingAddr], length);
+	return true;
+}
+
+static void EEPROM_sendCommand(EEPROM_Device* dev, uint8_t opcode)
+{
+	EEPROM_transfer(dev, &opcode, 1, NULL, NULL, 0);
 }
 
-void EEPROM_writeStatusReg(SPIDriver* spip, uint8_t cmd)
+/**
+ * @brief Update the state kept in the descriptor from a status register value.
+ */
+static void EEPROM_noteStatus(EEPROM_Device* dev, uint8_t status)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_WRITE_STATUS_REG);
-	EEPROM_exchangeSpi(spip, cmd);
-	EEPROM_setChipSelect();
+	if ((status & EEPROM_STATUS_BIT_RDY) == 0)
+	{
+		// the other bits are only valid once the device is ready
+		dev->busy = false;
+		dev->writeEnabled = ((status & EEPROM_STATUS_BIT_WEN) != 0);
+		dev->protection = status & (EEPROM_STATUS_BIT_BP | EEPROM_STATUS_BIT_WPEN);
+		dev->protectionValid = true;
+	}
 }
 
-uint8_t EEPROM_readByte(SPIDriver* spip, uint16_t addr)
+static uint8_t EEPROM_readStatus(EEPROM_Device* dev)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_READ_DATA);
-	EEPROM_exchangeSpi(spip, (addr >> 8));
-	EEPROM_exchangeSpi(spip, (addr & 0xFF));
-	uint8_t retVal = EEPROM_exchangeSpi(spip, 0);
-	EEPROM_setChipSelect();
+	uint8_t opcode = EEPROM_SPI_READ_STATUS_REG;
+	uint8_t retVal;
+
+	EEPROM_transfer(dev, &opcode, 1, NULL, &retVal, 1);
+	EEPROM_noteStatus(dev, retVal);
 	return retVal;
 }
 
-void EEPROM_writeByte(SPIDriver* spip, uint16_t addr, uint8_t data)
+/**
+ * @brief Set the write enable latch unless it is known to be set.
+ */
+static void EEPROM_setWriteLatch(EEPROM_Device* dev)
+{
+	if (!dev->writeEnabled)
+	{
+		EEPROM_sendCommand(dev, EEPROM_SPI_ENABLE_WRITE);
+		dev->writeEnabled = true;
+	}
+}
+
+/**
+ * @brief Wait for the write cycle started by this driver, if any.
+ *
+ * Instructions other than RDSR are ignored during a write cycle. Must be called with
+ * the bus locked, the lock is released while sleeping.
+ */
+static EEPROM_Result EEPROM_waitIdle(EEPROM_Device* dev)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_WRITE_DATA);
-	EEPROM_exchangeSpi(spip, (addr >> 8));
-	EEPROM_exchangeSpi(spip, (addr & 0xFF));
-	EEPROM_exchangeSpi(spip, data);
-	EEPROM_setChipSelect();
+	if (!dev->busy)
+	{
+		return Result_Ok;
+	}
+	return EEPROM_waitReady(dev);
 }
 
-void EEPROM_readRange(SPIDriver* spip, uint16_t startAddr, uint8_t* data, uint32_t length)
+/**
+ * @brief Read back the completed page write and check it.
+ */
+static bool EEPROM_readBack(EEPROM_Device* dev)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_READ_DATA);
-	EEPROM_exchangeSpi(spip, (startAddr >> 8));
-	EEPROM_exchangeSpi(spip, (startAddr & 0xFF));
+	uint8_t header[EEPROM_MAX_HEADER_SIZE];
+	uint32_t headerLength;
+	uint16_t crc = EEPROM_CRC16_INIT;
+	bool match = true;
 
-	for (uint32_t i = 0; i < length; i++)
+	if (EEPROM_usesBlockTransfer(dev, dev->pendingLength))
+	{
+		uint8_t page[EEPROM_MAX_PAGE_SIZE];
+		EEPROM_readDevice(dev, dev->pendingAddr, page, dev->pendingLength);
+		if (dev->verifyMode == VerifyMode_Crc)
+		{
+			return (EEPROM_crc16(crc, page, dev->pendingLength) == dev->pendingCrc);
+		}
+		return (memcmp(page, dev->pending, dev->pendingLength) == 0);
+	}
+
+	// checked as the bytes arrive, without a buffer
+	headerLength = EEPROM_buildHeader(dev, EEPROM_SPI_READ_DATA, dev->pendingAddr, header);
+	EEPROM_beginTransaction(dev, header[0]);
+	dev->hal->select(dev);
+	for (uint32_t i = 0; i < headerLength; i++)
+	{
+		dev->hal->exchange(dev, header[i]);
+	}
+	for (uint32_t i = 0; i < dev->pendingLength; i++)
 	{
-		data[i] = EEPROM_exchangeSpi(spip, 0);
+		uint8_t data = dev->hal->exchange(dev, 0);
+		if (dev->verifyMode == VerifyMode_Crc)
+		{
+			crc = EEPROM_CRC16_UPDATE(crc, data);
+		}
+		else
+		{
+			match = match && (data == dev->pending[i]);
+		}
 	}
-	EEPROM_setChipSelect();
+	dev->hal->deselect(dev);
+	EEPROM_endTransaction(dev, header[0], headerLength + dev->pendingLength);
+
+	return (dev->verifyMode == VerifyMode_Crc) ? (crc == dev->pendingCrc) : match;
 }
 
-void EEPROM_writeRange(SPIDriver* spip, uint16_t startAddr, uint8_t* data, uint32_t length)
+/**
+ * @brief Verify the completed page write, with the bus locked and the device ready.
+ *
+ * @return Result_Ok if there is nothing to verify or the page matches, Result_Busy if
+ *         the page is being written again, Result_VerifyError if no rewrite is left.
+ */
+static EEPROM_Result EEPROM_checkWrite(EEPROM_Device* dev)
 {
-	EEPROM_clearChipSelect();
-	EEPROM_exchangeSpi(spip, EEPROM_SPI_WRITE_DATA);
-	EEPROM_exchangeSpi(spip, (startAddr >> 8));
-	EEPROM_exchangeSpi(spip, (startAddr & 0xFF));
+	uint8_t attempts = dev->verifyAttempts;
 
-	for (uint32_t i = 0; i < length; i++)
+	if (!dev->verifyPending)
+	{
+		return Result_Ok;
+	}
+	if (EEPROM_readBack(dev))
 	{
-		EEPROM_exchangeSpi(spip, data[i]);
+		dev->verifyPending = false;
+		return Result_Ok;
 	}
-	EEPROM_setChipSelect();
+	if (attempts >= dev->verifyRetries)
+	{
+		dev->verifyPending = false;
+		return Result_VerifyError;
+	}
+
+	// only the failing page is written again
+	EEPROM_setWriteLatch(dev);
+	EEPROM_writePage(dev, dev->pendingAddr, dev->pending, dev->pendingLength);
+	dev->verifyAttempts = attempts + 1;
+	return Result_Busy;
 }
 
-void EEPROM_wait(SPIDriver* spip)
+/**
+ * @brief Wait for the write cycle started by this driver and verify the page written.
+ *
+ * Must precede every new page write and WREN, since a rewrite of a failing page uses
+ * the write enable latch. Must be called with the bus locked.
+ */
+static EEPROM_Result EEPROM_waitWritten(EEPROM_Device* dev)
 {
-	while(1)
+	EEPROM_Result result;
+
+	do
 	{
-		uint8_t status;
-		status = EEPROM_readStatusReg(spip);
+		result = EEPROM_waitIdle(dev);
+		if (result == Result_Ok)
+		{
+			result = EEPROM_checkWrite(dev);
+		}
+	} while (result == Result_Busy);
+	return result;
+}
 
-		if ((status & EEPROM_STATUS_BIT_RDY) == 0)
+/**
+ * @brief Check a range against the block protection, with the bus locked.
+ *
+ * The status register is only read if the kept block protection is invalid. It is
+ * only valid once the device is ready. With @p wait the status is polled until the
+ * device is ready, also for a write cycle the driver did not start itself. Without
+ * @p wait a single status is read and Result_Busy is returned if it is not ready.
+ *
+ * @return Result_Ok, Result_Protected if the range touches a protected page,
+ *         Result_Timeout with @p wait or Result_Busy without it if the block
+ *         protection could not be read.
+ */
+static EEPROM_Result EEPROM_checkProtection(EEPROM_Device* dev, uint32_t addr, uint32_t length, bool wait)
+{
+	uint32_t start = addr % dev->capacity;
+	uint32_t protectedFrom = dev->capacity;
+
+	if (length == 0)
+	{
+		return Result_Ok;
+	}
+	if (!dev->protectionValid)
+	{
+		if (wait)
 		{
-			break;
+			// the last status poll of the wait updates the block protection
+			EEPROM_Result result = EEPROM_waitReady(dev);
+			if (result != Result_Ok)
+			{
+				return result;
+			}
+		}
+		else
+		{
+			EEPROM_readStatus(dev);
 		}
+		if (!dev->protectionValid)
+		{
+			return Result_Busy;
+		}
+	}
+
+	switch ((EEPROM_BlockProtection)((dev->protection & EEPROM_STATUS_BIT_BP) >> 2))
+	{
+	case BlockProtection_Quarter:
+		protectedFrom = dev->capacity - dev->capacity / 4;
+		break;
+
+	case BlockProtection_Half:
+		protectedFrom = dev->capacity / 2;
+		break;
 
-		// wait for 1us
-		osalThreadDelayMicroseconds(1);
+	case BlockProtection_WholeMemory:
+		protectedFrom = 0;
+		break;
+
+	default:
+		break;
 	}
+
+	// a range past the end of the array wraps around and covers its last byte
+	if ((protectedFrom < dev->capacity) && (start + length > protectedFrom))
+	{
+		return Result_Protected;
+	}
+	return Result_Ok;
+}
+
+void EEPROM_enableWrite(EEPROM_Device* dev)
+{
+	EEPROM_lock(dev);
+	EEPROM_waitWritten(dev);
+	EEPROM_sendCommand(dev, EEPROM_SPI_ENABLE_WRITE);
+	dev->writeEnabled = true;
+	EEPROM_unlock(dev);
+}
+
+void EEPROM_disableWrite(EEPROM_Device* dev)
+{
+	EEPROM_lock(dev);
+	EEPROM_waitIdle(dev);
+	EEPROM_sendCommand(dev, EEPROM_SPI_DISABLE_WRITE);
+	dev->writeEnabled = false;
+	EEPROM_unlock(dev);
+}
+
+uint8_t EEPROM_readStatusReg(EEPROM_Device* dev)
+{
+	uint8_t retVal;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	retVal = EEPROM_readStatus(dev);
+	EEPROM_API_EXIT(dev, Api_ReadStatus);
+	EEPROM_unlock(dev);
+	return retVal;
+}
+
+EEPROM_Result EEPROM_writeStatusReg(EEPROM_Device* dev, uint8_t cmd)
+{
+	uint8_t opcode = EEPROM_SPI_WRITE_STATUS_REG;
+	EEPROM_Result result;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	// the previous page is verified before its copy is dropped
+	result = EEPROM_waitWritten(dev);
+	if (result == Result_Ok)
+	{
+		EEPROM_setWriteLatch(dev);
+		EEPROM_transfer(dev, &opcode, 1, &cmd, NULL, 1);
+		dev->busy = true;
+		dev->writeEnabled = false;
+		dev->pendingLength = 0;
+		dev->verifyPending = false;
+		dev->protectionValid = false;
+	}
+	EEPROM_API_EXIT(dev, Api_WriteStatus);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+#if EEPROM_USE_CACHE == TRUE
+static void EEPROM_cacheRead(EEPROM_Device* dev, uint32_t addr, uint8_t* data, uint32_t length)
+{
+	uint32_t offset = addr % dev->capacity;
+
+	// wraps at the end of the array like the device does
+	while (length > 0)
+	{
+		uint32_t chunk = dev->capacity - offset;
+		if (chunk > length)
+		{
+			chunk = length;
+		}
+		memcpy(data, &dev->cache[offset], chunk);
+
+		data += chunk;
+		length -= chunk;
+		offset = 0;
+	}
+}
+
+static void EEPROM_cacheMarkDirty(EEPROM_Device* dev, uint32_t offset, uint32_t length)
+{
+	uint32_t last = (offset + length - 1) / dev->pageSize;
+
+	for (uint32_t page = offset / dev->pageSize; page <= last; page++)
+	{
+		dev->cacheDirty[page / 8] |= (1 << (page % 8));
+	}
+}
+
+static void EEPROM_cacheWrite(EEPROM_Device* dev, uint32_t addr, const uint8_t* data, uint32_t length, bool markDirty)
+{
+	uint32_t offset = addr % dev->capacity;
+
+	while (length > 0)
+	{
+		uint32_t chunk = dev->capacity - offset;
+		if (chunk > length)
+		{
+			chunk = length;
+		}
+		memcpy(&dev->cache[offset], data, chunk);
+		if (markDirty)
+		{
+			EEPROM_cacheMarkDirty(dev, offset, chunk);
+		}
+
+		data += chunk;
+		length -= chunk;
+		offset = 0;
+	}
+}
+
+/**
+ * @brief Find the first run of adjacent dirty pages and mark it clean.
+ */
+static bool EEPROM_cacheTakeDirtyRun(EEPROM_Device* dev, uint32_t* firstPage, uint32_t* pageCount)
+{
+	uint32_t pages = dev->capacity / dev->pageSize;
+	uint32_t page = 0;
+
+	while ((page < pages) && !(dev->cacheDirty[page / 8] & (1 << (page % 8))))
+	{
+		page++;
+	}
+	if (page == pages)
+	{
+		return false;
+	}
+
+	*firstPage = page;
+	while ((page < pages) && (dev->cacheDirty[page / 8] & (1 << (page % 8))))
+	{
+		dev->cacheDirty[page / 8] &= ~(1 << (page % 8));
+		page++;
+	}
+	*pageCount = page - *firstPage;
+	return true;
+}
+#endif
+
+uint8_t EEPROM_readByte(EEPROM_Device* dev, uint32_t addr)
+{
+	uint8_t retVal;
+
+	EEPROM_readRange(dev, addr, &retVal, 1);
+	return retVal;
+}
+
+void EEPROM_writeByte(EEPROM_Device* dev, uint32_t addr, uint8_t data)
+{
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	if (EEPROM_checkProtection(dev, addr, 1, true) != Result_Ok)
+	{
+		// dropped without a bus transfer, as the device would drop it
+	}
+#if EEPROM_USE_CACHE == TRUE
+	else if (dev->cacheValid)
+	{
+		EEPROM_cacheWrite(dev, addr, &data, 1, true);
+	}
+#endif
+	else
+	{
+		EEPROM_waitWritten(dev);
+		EEPROM_setWriteLatch(dev);
+		EEPROM_writePage(dev, addr, &data, 1);
+	}
+	EEPROM_API_EXIT(dev, Api_WriteByte);
+	EEPROM_unlock(dev);
+}
+
+void EEPROM_readRange(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+#if EEPROM_USE_CACHE == TRUE
+	if (dev->cacheValid)
+	{
+		// served from RAM, also while the device is busy
+		EEPROM_cacheRead(dev, startAddr, data, length);
+	}
+	else
+#endif
+	if (!EEPROM_readPending(dev, startAddr, data, length))
+	{
+		EEPROM_waitIdle(dev);
+		EEPROM_readDevice(dev, startAddr, data, length);
+	}
+	EEPROM_API_EXIT(dev, Api_ReadRange);
+	EEPROM_unlock(dev);
+}
+
+/**
+ * @brief Check that a range lies within the memory array, without overflowing.
+ */
+static bool EEPROM_rangeFits(const EEPROM_Device* dev, uint32_t addr, uint32_t length)
+{
+	return ((addr <= dev->capacity) && (length <= dev->capacity - addr));
+}
+
+EEPROM_Result EEPROM_readRangeChecked(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	if (!EEPROM_rangeFits(dev, startAddr, length))
+	{
+		return Result_OutOfRange;
+	}
+	EEPROM_readRange(dev, startAddr, data, length);
+	return Result_Ok;
+}
+
+EEPROM_Result EEPROM_readRangeWrapped(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	uint32_t addr;
+	uint32_t head;
+
+	if (length > dev->capacity)
+	{
+		return Result_OutOfRange;
+	}
+
+	addr = startAddr % dev->capacity;
+	head = dev->capacity - addr;
+	if (length <= head)
+	{
+		EEPROM_readRange(dev, addr, data, length);
+	}
+	else
+	{
+		EEPROM_iovec v[2] =
+		{
+			{addr, data, head},
+			{0, &data[head], length - head},
+		};
+		EEPROM_readv(dev, v, 2);
+	}
+	return Result_Ok;
+}
+
+/**
+ * @brief Read a record and its stored CRC-16 from the device.
+ *
+ * @return The CRC-16 over the record and the stored CRC, 0 if they match.
+ */
+static uint16_t EEPROM_readDeviceCrc(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	uint8_t header[EEPROM_MAX_HEADER_SIZE];
+	uint16_t crc = EEPROM_CRC16_INIT;
+	uint32_t headerLength;
+
+	if (EEPROM_usesBlockTransfer(dev, length))
+	{
+		// the data is not seen byte by byte, check the received buffer
+		uint8_t stored[EEPROM_CRC16_SIZE];
+		EEPROM_readDevice(dev, startAddr, data, length);
+		EEPROM_readDevice(dev, startAddr + length, stored, sizeof(stored));
+		crc = EEPROM_crc16(crc, data, length);
+		return EEPROM_crc16(crc, stored, sizeof(stored));
+	}
+
+	headerLength = EEPROM_buildHeader(dev, EEPROM_SPI_READ_DATA, startAddr, header);
+	EEPROM_beginTransaction(dev, header[0]);
+	dev->hal->select(dev);
+	for (uint32_t i = 0; i < headerLength; i++)
+	{
+		dev->hal->exchange(dev, header[i]);
+	}
+	for (uint32_t i = 0; i < length; i++)
+	{
+		data[i] = dev->hal->exchange(dev, 0);
+		crc = EEPROM_CRC16_UPDATE(crc, data[i]);
+	}
+	for (uint32_t i = 0; i < EEPROM_CRC16_SIZE; i++)
+	{
+		crc = EEPROM_CRC16_UPDATE(crc, dev->hal->exchange(dev, 0));
+	}
+	dev->hal->deselect(dev);
+	EEPROM_endTransaction(dev, header[0], headerLength + length + EEPROM_CRC16_SIZE);
+	return crc;
+}
+
+EEPROM_Result EEPROM_readRangeVerified(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	uint8_t stored[EEPROM_CRC16_SIZE];
+	uint16_t crc;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+#if EEPROM_USE_CACHE == TRUE
+	if (dev->cacheValid)
+	{
+		EEPROM_cacheRead(dev, startAddr, data, length);
+		EEPROM_cacheRead(dev, startAddr + length, stored, sizeof(stored));
+		crc = EEPROM_crc16(EEPROM_crc16(EEPROM_CRC16_INIT, data, length), stored, sizeof(stored));
+	}
+	else
+#endif
+	if (EEPROM_readPending(dev, startAddr, data, length) &&
+		EEPROM_readPending(dev, startAddr + length, stored, sizeof(stored)))
+	{
+		crc = EEPROM_crc16(EEPROM_crc16(EEPROM_CRC16_INIT, data, length), stored, sizeof(stored));
+	}
+	else
+	{
+		EEPROM_waitIdle(dev);
+		crc = EEPROM_readDeviceCrc(dev, startAddr, data, length);
+	}
+	EEPROM_API_EXIT(dev, Api_ReadRangeVerified);
+	EEPROM_unlock(dev);
+
+	return (crc == 0) ? Result_Ok : Result_CrcError;
+}
+
+/**
+ * @brief Sort the requests of a scatter gather transfer by address.
+ */
+static void EEPROM_sortIovec(const EEPROM_iovec* v, uint8_t* order, uint32_t n)
+{
+	for (uint32_t i = 0; i < n; i++)
+	{
+		uint32_t j = i;
+		while ((j > 0) && (v[order[j - 1]].addr > v[i].addr))
+		{
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+}
+
+static void EEPROM_readvChunk(EEPROM_Device* dev, const EEPROM_iovec* v, uint32_t n)
+{
+	uint8_t order[EEPROM_READV_MAX_IOV];
+	uint8_t span[EEPROM_READV_SPAN];
+	uint32_t i = 0;
+
+	EEPROM_sortIovec(v, order, n);
+
+	while (i < n)
+	{
+		const EEPROM_iovec* first = &v[order[i]];
+		uint32_t start = first->addr;
+		uint32_t end = start + first->len;
+		uint32_t last = i + 1;
+
+		if (first->len > EEPROM_READV_SPAN)
+		{
+			EEPROM_readDevice(dev, first->addr, first->buf, first->len);
+			i++;
+			continue;
+		}
+
+		// extend the span while the next request is close enough and fits
+		while (last < n)
+		{
+			const EEPROM_iovec* next = &v[order[last]];
+			uint32_t nextEnd = next->addr + next->len;
+			if ((next->addr > end + dev->readvGap) || (((nextEnd > end) ? nextEnd : end) - start > EEPROM_READV_SPAN))
+			{
+				break;
+			}
+			if (nextEnd > end)
+			{
+				end = nextEnd;
+			}
+			last++;
+		}
+
+		if (last == i + 1)
+		{
+			EEPROM_readDevice(dev, first->addr, first->buf, first->len);
+		}
+		else
+		{
+			EEPROM_readDevice(dev, start, span, end - start);
+			for (uint32_t k = i; k < last; k++)
+			{
+				const EEPROM_iovec* req = &v[order[k]];
+				memcpy(req->buf, &span[req->addr - start], req->len);
+			}
+		}
+		i = last;
+	}
+}
+
+void EEPROM_readv(EEPROM_Device* dev, const EEPROM_iovec* v, uint32_t n)
+{
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+#if EEPROM_USE_CACHE == TRUE
+	if (dev->cacheValid)
+	{
+		for (uint32_t i = 0; i < n; i++)
+		{
+			EEPROM_cacheRead(dev, v[i].addr, v[i].buf, v[i].len);
+		}
+	}
+	else
+#endif
+	{
+		bool pending = true;
+		for (uint32_t i = 0; (i < n) && pending; i++)
+		{
+			pending = EEPROM_readPending(dev, v[i].addr, v[i].buf, v[i].len);
+		}
+		if (pending)
+		{
+			EEPROM_API_EXIT(dev, Api_Readv);
+			EEPROM_unlock(dev);
+			return;
+		}
+
+		EEPROM_waitIdle(dev);
+		for (uint32_t i = 0; i < n; i += EEPROM_READV_MAX_IOV)
+		{
+			uint32_t count = n - i;
+			if (count > EEPROM_READV_MAX_IOV)
+			{
+				count = EEPROM_READV_MAX_IOV;
+			}
+			EEPROM_readvChunk(dev, &v[i], count);
+		}
+	}
+	EEPROM_API_EXIT(dev, Api_Readv);
+	EEPROM_unlock(dev);
+}
+
+static uint32_t EEPROM_pageChunk(EEPROM_Device* dev, uint32_t addr, uint32_t length)
+{
+	// number of bytes left until the end of the current page
+	uint32_t chunk = dev->pageSize - (addr % dev->pageSize);
+	if (chunk > length)
+	{
+		chunk = length;
+	}
+	return chunk;
+}
+
+/**
+ * @brief Find the first and the last differing byte of two buffers.
+ */
+static bool EEPROM_findChange(const uint8_t* current, const uint8_t* data, uint32_t length,
+							  uint32_t* first, uint32_t* last)
+{
+	uint32_t begin = 0;
+	uint32_t end = length;
+
+	while ((begin < length) && (current[begin] == data[begin]))
+	{
+		begin++;
+	}
+	if (begin == length)
+	{
+		return false;
+	}
+	while (current[end - 1] == data[end - 1])
+	{
+		end--;
+	}
+
+	*first = begin;
+	*last = end - 1;
+	return true;
+}
+
+static void EEPROM_writeNextPage(EEPROM_WriteJob* job)
+{
+	uint32_t chunk = EEPROM_pageChunk(job->dev, job->addr, job->remaining);
+
+	EEPROM_setWriteLatch(job->dev);
+	EEPROM_writePage(job->dev, job->addr, job->data, chunk);
+
+	job->addr += chunk;
+	job->data += chunk;
+	job->remaining -= chunk;
+}
+
+static EEPROM_Result EEPROM_writeDevice(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	EEPROM_WriteJob job = {dev, startAddr, data, length, NULL, NULL, false, Result_Ok, startAddr, length};
+
+	while (job.remaining > 0)
+	{
+		EEPROM_Result result = EEPROM_waitWritten(dev);
+		if (result != Result_Ok)
+		{
+			return result;
+		}
+
+		EEPROM_writeNextPage(&job);
+	}
+	return Result_Ok;
+}
+
+EEPROM_Result EEPROM_writeRange(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	EEPROM_Result result;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	result = EEPROM_checkProtection(dev, startAddr, length, true);
+	if (result != Result_Ok)
+	{
+		// rejected before the bus is touched
+	}
+#if EEPROM_USE_CACHE == TRUE
+	else if (dev->cacheValid)
+	{
+		EEPROM_cacheWrite(dev, startAddr, data, length, true);
+	}
+#endif
+	else
+	{
+		result = EEPROM_writeDevice(dev, startAddr, data, length);
+	}
+	EEPROM_API_EXIT(dev, Api_WriteRange);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+EEPROM_Result EEPROM_writeRangeChecked(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	if (!EEPROM_rangeFits(dev, startAddr, length))
+	{
+		return Result_OutOfRange;
+	}
+	return EEPROM_writeRange(dev, startAddr, data, length);
+}
+
+static EEPROM_Result EEPROM_writeDiff(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	uint32_t first;
+	uint32_t last;
+	EEPROM_Result result = EEPROM_checkProtection(dev, startAddr, length, true);
+
+	if (result != Result_Ok)
+	{
+		return result;
+	}
+
+#if EEPROM_USE_CACHE == TRUE
+	if (dev->cacheValid)
+	{
+		while (length > 0)
+		{
+			uint32_t chunk = EEPROM_pageChunk(dev, startAddr, length);
+
+			// a page never crosses the end of the array
+			if (EEPROM_findChange(&dev->cache[startAddr % dev->capacity], data, chunk, &first, &last))
+			{
+				EEPROM_cacheWrite(dev, startAddr + first, &data[first], last - first + 1, true);
+			}
+
+			startAddr += chunk;
+			data += chunk;
+			length -= chunk;
+		}
+		return Result_Ok;
+	}
+#endif
+
+	while (length > 0)
+	{
+		uint8_t current[EEPROM_MAX_PAGE_SIZE];
+		uint32_t chunk = EEPROM_pageChunk(dev, startAddr, length);
+
+		// the array can only be read once the previous write has completed
+		result = EEPROM_waitWritten(dev);
+		if (result != Result_Ok)
+		{
+			return result;
+		}
+
+		EEPROM_readDevice(dev, startAddr, current, chunk);
+		if (EEPROM_findChange(current, data, chunk, &first, &last))
+		{
+			EEPROM_setWriteLatch(dev);
+			EEPROM_writePage(dev, startAddr + first, &data[first], last - first + 1);
+		}
+
+		startAddr += chunk;
+		data += chunk;
+		length -= chunk;
+	}
+	return Result_Ok;
+}
+
+/**
+ * @brief Find the lowest address at or above @p cursor written by a request.
+ *
+ * @return false if no request writes at or above @p cursor.
+ */
+static bool EEPROM_nextWrite(const EEPROM_iovec* v, uint32_t n, uint32_t cursor, uint32_t* addr)
+{
+	uint32_t next = 0;
+	bool found = false;
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if ((v[i].len > 0) && (v[i].addr + v[i].len > cursor))
+		{
+			uint32_t start = (v[i].addr > cursor) ? v[i].addr : cursor;
+			if (!found || (start < next))
+			{
+				next = start;
+				found = true;
+			}
+		}
+	}
+	*addr = next;
+	return found;
+}
+
+EEPROM_Result EEPROM_writeRangeDiff(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	EEPROM_Result result;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	result = EEPROM_writeDiff(dev, startAddr, data, length);
+	EEPROM_API_EXIT(dev, Api_WriteRangeDiff);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+static EEPROM_Result EEPROM_writeScattered(EEPROM_Device* dev, const EEPROM_iovec* v, uint32_t n)
+{
+	uint32_t addr = 0;
+	uint32_t cursor = 0;
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		EEPROM_Result result = EEPROM_checkProtection(dev, v[i].addr, v[i].len, true);
+		if (result != Result_Ok)
+		{
+			return result;
+		}
+	}
+
+#if EEPROM_USE_CACHE == TRUE
+	if (dev->cacheValid)
+	{
+		for (uint32_t i = 0; i < n; i++)
+		{
+			EEPROM_cacheWrite(dev, v[i].addr, v[i].buf, v[i].len, true);
+		}
+		return Result_Ok;
+	}
+#endif
+
+	while (EEPROM_nextWrite(v, n, cursor, &addr))
+	{
+		uint8_t page[EEPROM_MAX_PAGE_SIZE];
+		bool covered[EEPROM_MAX_PAGE_SIZE];
+		uint32_t pageStart = addr - (addr % dev->pageSize);
+		uint32_t pageEnd = pageStart + dev->pageSize;
+		uint32_t lo = dev->pageSize;
+		uint32_t hi = 0;
+		bool gaps = false;
+
+		memset(covered, 0, sizeof(covered));
+		for (uint32_t i = 0; i < n; i++)
+		{
+			uint32_t start = (v[i].addr > pageStart) ? v[i].addr : pageStart;
+			uint32_t end = (v[i].addr + v[i].len < pageEnd) ? v[i].addr + v[i].len : pageEnd;
+			for (uint32_t a = start; a < end; a++)
+			{
+				covered[a - pageStart] = true;
+			}
+			if (start < end)
+			{
+				lo = (start - pageStart < lo) ? start - pageStart : lo;
+				hi = (end - pageStart > hi) ? end - pageStart : hi;
+			}
+		}
+		for (uint32_t i = lo; i < hi; i++)
+		{
+			gaps |= !covered[i];
+		}
+
+		// the array can only be read once the previous write has completed
+		EEPROM_Result result = EEPROM_waitWritten(dev);
+		if (result != Result_Ok)
+		{
+			return result;
+		}
+
+		if (gaps)
+		{
+			EEPROM_readDevice(dev, pageStart + lo, &page[lo], hi - lo);
+		}
+
+		// later requests win where requests overlap
+		for (uint32_t i = 0; i < n; i++)
+		{
+			uint32_t start = (v[i].addr > pageStart) ? v[i].addr : pageStart;
+			uint32_t end = (v[i].addr + v[i].len < pageEnd) ? v[i].addr + v[i].len : pageEnd;
+			if (start < end)
+			{
+				memcpy(&page[start - pageStart], &v[i].buf[start - v[i].addr], end - start);
+			}
+		}
+
+		EEPROM_setWriteLatch(dev);
+		EEPROM_writePage(dev, pageStart + lo, &page[lo], hi - lo);
+		cursor = pageEnd;
+	}
+	return Result_Ok;
+}
+
+EEPROM_Result EEPROM_writev(EEPROM_Device* dev, const EEPROM_iovec* v, uint32_t n)
+{
+	EEPROM_Result result;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	result = EEPROM_writeScattered(dev, v, n);
+	EEPROM_API_EXIT(dev, Api_Writev);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+EEPROM_Result EEPROM_writeRangeCrc(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length)
+{
+	uint16_t crc = EEPROM_crc16(EEPROM_CRC16_INIT, data, length);
+	uint8_t stored[EEPROM_CRC16_SIZE] = {crc >> 8, crc & 0xFF};
+	EEPROM_iovec v[2] =
+	{
+		{startAddr, data, length},
+		{startAddr + length, stored, sizeof(stored)},
+	};
+
+	return EEPROM_writev(dev, v, 2);
+}
+
+/**
+ * @brief Prepare one page part, with the bus unlocked.
+ */
+static bool EEPROM_preparePage(EEPROM_Device* dev, uint32_t addr, const uint8_t* src, uint8_t* dst,
+							   uint32_t length, EEPROM_PagePrep prep, void* ctx)
+{
+	bool write = true;
+
+	EEPROM_unlock(dev);
+	if (prep != NULL)
+	{
+		write = prep(dev, addr, src, dst, length, ctx);
+	}
+	else
+	{
+		memcpy(dst, src, length);
+	}
+	EEPROM_lock(dev);
+	return write;
+}
+
+EEPROM_Result EEPROM_writeRangePipelined(EEPROM_Device* dev, uint32_t startAddr, const uint8_t* data,
+										 uint32_t length, EEPROM_PagePrep prep, void* ctx)
+{
+	uint8_t page[EEPROM_MAX_PAGE_SIZE];
+	uint32_t chunk = EEPROM_pageChunk(dev, startAddr, length);
+	EEPROM_Result result;
+	bool write;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	result = EEPROM_checkProtection(dev, startAddr, length, true);
+	if ((result != Result_Ok) || (length == 0))
+	{
+		EEPROM_API_EXIT(dev, Api_WriteRangePipelined);
+		EEPROM_unlock(dev);
+		return result;
+	}
+
+	write = EEPROM_preparePage(dev, startAddr, data, page, chunk, prep, ctx);
+	while (1)
+	{
+		if (write)
+		{
+#if EEPROM_USE_CACHE == TRUE
+			if (dev->cacheValid)
+			{
+				EEPROM_cacheWrite(dev, startAddr, page, chunk, true);
+			}
+			else
+#endif
+			{
+				result = EEPROM_waitWritten(dev);
+				if (result != Result_Ok)
+				{
+					break;
+				}
+				EEPROM_setWriteLatch(dev);
+				// copied to the descriptor, so the buffer is free for the next page
+				EEPROM_writePage(dev, startAddr, page, chunk);
+			}
+		}
+
+		startAddr += chunk;
+		data += chunk;
+		length -= chunk;
+		if (length == 0)
+		{
+			break;
+		}
+
+		// overlaps the write cycle of the page just started
+		chunk = EEPROM_pageChunk(dev, startAddr, length);
+		write = EEPROM_preparePage(dev, startAddr, data, page, chunk, prep, ctx);
+	}
+	EEPROM_API_EXIT(dev, Api_WriteRangePipelined);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+/**
+ * @brief Advance the asynchronous write by one status poll, with the bus locked.
+ *
+ * @return true if the write has just completed, the callback is then due.
+ */
+static bool EEPROM_asyncStep(EEPROM_Device* dev)
+{
+	EEPROM_WriteJob* job = &dev->job;
+
+	EEPROM_Result result;
+
+	if ((EEPROM_readStatus(dev) & EEPROM_STATUS_BIT_RDY) != 0)
+	{
+		return false;
+	}
+
+	result = EEPROM_checkWrite(dev);
+	if (result == Result_Busy)
+	{
+		// the previous page is being written again
+		return false;
+	}
+
+	job->result = result;
+	if ((result == Result_Ok) && (job->remaining > 0))
+	{
+		EEPROM_writeNextPage(job);
+		return false;
+	}
+
+	// cleared before the callback so that it can start the next write
+	job->active = false;
+	return true;
+}
+
+/**
+ * @brief Start an asynchronous write, with the bus locked and no write in progress.
+ *
+ * @return true if the write has already completed, the callback is then due.
+ */
+static bool EEPROM_startAsync(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length,
+							  EEPROM_Callback cb, void* ctx)
+{
+	EEPROM_WriteJob* job = &dev->job;
+
+	job->dev = dev;
+	job->addr = startAddr;
+	job->data = data;
+	job->remaining = length;
+	job->cb = cb;
+	job->ctx = ctx;
+	job->active = true;
+	job->result = Result_Ok;
+	job->startAddr = startAddr;
+	job->length = length;
+
+	return EEPROM_asyncStep(dev);
+}
+
+/**
+ * @brief Call the completion callback of a write, with the bus unlocked.
+ */
+static void EEPROM_completeAsync(EEPROM_Device* dev, EEPROM_Callback cb, void* ctx, EEPROM_Result result)
+{
+	if (cb != NULL)
+	{
+		cb(dev, result, ctx);
+	}
+}
+
+EEPROM_Result EEPROM_writeRangeAsync(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length,
+									 EEPROM_Callback cb, void* ctx)
+{
+	EEPROM_Result result;
+	bool done;
+
+	EEPROM_lock(dev);
+	if (dev->job.active)
+	{
+		EEPROM_unlock(dev);
+		return Result_Busy;
+	}
+	result = EEPROM_checkProtection(dev, startAddr, length, false);
+	if (result != Result_Ok)
+	{
+		EEPROM_unlock(dev);
+		return result;
+	}
+
+#if EEPROM_USE_CACHE == TRUE
+	if (dev->cacheValid)
+	{
+		// written through to the device, so the cached pages stay clean
+		EEPROM_cacheWrite(dev, startAddr, data, length, false);
+	}
+#endif
+
+	done = EEPROM_startAsync(dev, startAddr, data, length, cb, ctx);
+	result = dev->job.result;
+	EEPROM_unlock(dev);
+
+	if (done)
+	{
+		EEPROM_completeAsync(dev, cb, ctx, result);
+	}
+	return Result_Ok;
+}
+
+/**
+ * @brief Advance the work of a device by one step, with the bus locked.
+ *
+ * @return Result_Busy while work is left, otherwise the result of the work.
+ */
+static EEPROM_Result EEPROM_step(EEPROM_Device* dev, bool* done)
+{
+	*done = false;
+	if (dev->job.active)
+	{
+		*done = EEPROM_asyncStep(dev);
+		return *done ? dev->job.result : Result_Busy;
+	}
+
+	// the last page of a blocking write, or a status register write
+	if (dev->busy && ((EEPROM_readStatus(dev) & EEPROM_STATUS_BIT_RDY) != 0))
+	{
+		return Result_Busy;
+	}
+	return EEPROM_checkWrite(dev);
+}
+
+EEPROM_Result EEPROM_poll(EEPROM_Device* dev)
+{
+	EEPROM_WriteJob* job = &dev->job;
+	EEPROM_Callback cb;
+	void* ctx;
+	EEPROM_Result result;
+	bool done;
+
+	EEPROM_lock(dev);
+	cb = job->cb;
+	ctx = job->ctx;
+	result = EEPROM_step(dev, &done);
+	EEPROM_unlock(dev);
+
+	if (done)
+	{
+		EEPROM_completeAsync(dev, cb, ctx, result);
+
+		// the callback may have started the next write, as the flush does
+		EEPROM_lock(dev);
+		if (job->active)
+		{
+			result = Result_Busy;
+		}
+		EEPROM_unlock(dev);
+	}
+	return result;
+}
+
+bool EEPROM_asyncPoll(EEPROM_Device* dev)
+{
+	return (EEPROM_poll(dev) == Result_Busy);
+}
+
+#if EEPROM_USE_CACHE == TRUE
+void EEPROM_cacheLoad(EEPROM_Device* dev, uint8_t* cache, uint8_t* dirty)
+{
+	EEPROM_lock(dev);
+	dev->cache = cache;
+	dev->cacheDirty = dirty;
+
+	EEPROM_waitIdle(dev);
+	EEPROM_readDevice(dev, 0, dev->cache, dev->capacity);
+	memset(dev->cacheDirty, 0, EEPROM_CACHE_DIRTY_SIZE(dev->capacity, dev->pageSize));
+	dev->cacheValid = true;
+	EEPROM_unlock(dev);
+}
+
+void EEPROM_cacheInvalidate(EEPROM_Device* dev)
+{
+	EEPROM_lock(dev);
+	dev->cacheValid = false;
+	EEPROM_unlock(dev);
+}
+
+static EEPROM_Result EEPROM_flushDevice(EEPROM_Device* dev)
+{
+	uint32_t page;
+	uint32_t count;
+
+	while (EEPROM_cacheTakeDirtyRun(dev, &page, &count))
+	{
+		uint32_t offset = page * dev->pageSize;
+		uint32_t length = count * dev->pageSize;
+
+		EEPROM_Result result = EEPROM_checkProtection(dev, offset, length, true);
+		if (result == Result_Ok)
+		{
+			result = EEPROM_writeDevice(dev, offset, &dev->cache[offset], length);
+		}
+		if (result != Result_Ok)
+		{
+			// the run may be partly written, keep all of it for the next flush
+			EEPROM_cacheMarkDirty(dev, offset, length);
+			return result;
+		}
+	}
+	return EEPROM_waitWritten(dev);
+}
+
+EEPROM_Result EEPROM_flush(EEPROM_Device* dev)
+{
+	EEPROM_Result result;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	result = EEPROM_flushDevice(dev);
+	EEPROM_API_EXIT(dev, Api_Flush);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+static void EEPROM_flushNext(EEPROM_Device* dev, EEPROM_Result result, void* ctx)
+{
+	uint32_t page;
+	uint32_t count;
+
+	(void)ctx;
+	if (result != Result_Ok)
+	{
+		// the run of the failed job may be partly written, keep all of it
+		EEPROM_lock(dev);
+		EEPROM_cacheMarkDirty(dev, dev->job.startAddr, dev->job.length);
+		EEPROM_unlock(dev);
+	}
+
+	while (result == Result_Ok)
+	{
+		bool done;
+
+		EEPROM_lock(dev);
+		if (dev->job.active)
+		{
+			// another write was started in between
+			result = Result_Busy;
+		}
+		else if (EEPROM_cacheTakeDirtyRun(dev, &page, &count))
+		{
+			uint32_t offset = page * dev->pageSize;
+			result = EEPROM_checkProtection(dev, offset, count * dev->pageSize, false);
+			if (result != Result_Ok)
+			{
+				EEPROM_cacheMarkDirty(dev, offset, count * dev->pageSize);
+			}
+			else
+			{
+				done = EEPROM_startAsync(dev, offset, &dev->cache[offset], count * dev->pageSize, EEPROM_flushNext, NULL);
+				result = dev->job.result;
+				if (done && (result != Result_Ok))
+				{
+					EEPROM_cacheMarkDirty(dev, offset, count * dev->pageSize);
+				}
+				EEPROM_unlock(dev);
+				if (!done)
+				{
+					return;
+				}
+				continue;
+			}
+		}
+		EEPROM_unlock(dev);
+		break;
+	}
+
+	if (dev->flushCb != NULL)
+	{
+		dev->flushCb(dev, result, dev->flushCtx);
+	}
+}
+
+EEPROM_Result EEPROM_flushAsync(EEPROM_Device* dev, EEPROM_Callback cb, void* ctx)
+{
+	EEPROM_lock(dev);
+	if (dev->job.active)
+	{
+		EEPROM_unlock(dev);
+		return Result_Busy;
+	}
+	if (!dev->protectionValid)
+	{
+		// read here, so that the flush does not end at once with Result_Busy
+		EEPROM_readStatus(dev);
+		if (!dev->protectionValid)
+		{
+			EEPROM_unlock(dev);
+			return Result_Busy;
+		}
+	}
+
+	dev->flushCb = cb;
+	dev->flushCtx = ctx;
+	EEPROM_unlock(dev);
+
+	EEPROM_flushNext(dev, Result_Ok, NULL);
+	return Result_Ok;
+}
+#endif
+
+static EEPROM_Result EEPROM_waitReady(EEPROM_Device* dev)
+{
+	const EEPROM_WaitPolicy* policy = &dev->waitPolicy;
+	EEPROM_Result result = Result_Ok;
+	uint32_t elapsed = 0;
+	uint32_t delay = policy->initialDelayUs;
+	uint32_t interval = policy->minPollUs;
+	uint32_t polls = 0;
+	bool continuousRead = policy->continuousRead;
+
+#if EEPROM_USE_HW_CS == TRUE
+	// a burst needs its length up front
+	if (dev->pcsMask != 0)
+	{
+		continuousRead = false;
+	}
+#endif
+#if EEPROM_USE_MUTUAL_EXCLUSION == TRUE
+	// the bus is released between the polls
+	if (dev->busMutex != NULL)
+	{
+		continuousRead = false;
+	}
+#endif
+
+	if (continuousRead)
+	{
+		// the status register is shifted out repeatedly as long as CS stays low
+		EEPROM_beginTransaction(dev, EEPROM_SPI_READ_STATUS_REG);
+		dev->hal->select(dev);
+		dev->hal->exchange(dev, EEPROM_SPI_READ_STATUS_REG);
+	}
+
+	while (1)
+	{
+		uint8_t status;
+		if (continuousRead)
+		{
+			status = dev->hal->exchange(dev, 0);
+		}
+		else
+		{
+			status = EEPROM_readStatus(dev);
+		}
+		polls++;
+		EEPROM_STATS_ADD(dev, waitPolls, 1);
+
+		if ((status & EEPROM_STATUS_BIT_RDY) == 0)
+		{
+			EEPROM_noteStatus(dev, status);
+			break;
+		}
+
+		if (policy->timeoutUs != 0)
+		{
+			if (elapsed >= policy->timeoutUs)
+			{
+				result = Result_Timeout;
+				break;
+			}
+			if (delay > policy->timeoutUs - elapsed)
+			{
+				delay = policy->timeoutUs - elapsed;
+			}
+		}
+
+		// other threads may use the bus during the write cycle
+		EEPROM_unlock(dev);
+		dev->hal->delayUs(dev, delay);
+		EEPROM_lock(dev);
+		elapsed += delay;
+		EEPROM_STATS_ADD(dev, waitUs, delay);
+
+		delay = interval;
+		interval *= 2;
+		if (interval > policy->maxPollUs)
+		{
+			interval = policy->maxPollUs;
+		}
+	}
+
+	if (continuousRead)
+	{
+		dev->hal->deselect(dev);
+		EEPROM_endTransaction(dev, EEPROM_SPI_READ_STATUS_REG, 1 + polls);
+	}
+	return result;
+}
+
+EEPROM_Result EEPROM_wait(EEPROM_Device* dev)
+{
+	EEPROM_Result result;
+
+	EEPROM_API_ENTER(dev);
+	EEPROM_lock(dev);
+	result = EEPROM_waitReady(dev);
+	if (result == Result_Ok)
+	{
+		result = EEPROM_waitWritten(dev);
+	}
+	EEPROM_API_EXIT(dev, Api_Wait);
+	EEPROM_unlock(dev);
+	return result;
+}
+
+void EEPROM_setWaitPolicy(EEPROM_Device* dev, const EEPROM_WaitPolicy* policy)
+{
+	dev->waitPolicy = *policy;
+
+	// a zero interval would never grow
+	if (dev->waitPolicy.minPollUs == 0)
+	{
+		dev->waitPolicy.minPollUs = 1;
+	}
+	if (dev->waitPolicy.maxPollUs < dev->waitPolicy.minPollUs)
+	{
+		dev->waitPolicy.maxPollUs = dev->waitPolicy.minPollUs;
+	}
+}
+
+void EEPROM_setVerify(EEPROM_Device* dev, EEPROM_VerifyMode mode, uint8_t retries)
+{
+	EEPROM_lock(dev);
+	dev->verifyMode = mode;
+	dev->verifyRetries = retries;
+	// applies to the pages written from now on
+	dev->verifyPending = false;
+	EEPROM_unlock(dev);
+}
+
+#if EEPROM_USE_STATISTICS == TRUE
+void EEPROM_getStatistics(EEPROM_Device* dev, EEPROM_Statistics* stats)
+{
+	EEPROM_lock(dev);
+	*stats = dev->stats;
+	EEPROM_unlock(dev);
+}
+
+void EEPROM_resetStatistics(EEPROM_Device* dev)
+{
+	EEPROM_lock(dev);
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	EEPROM_unlock(dev);
+}
+#endif
+
+#if EEPROM_USE_TRACE == TRUE
+void EEPROM_setTrace(EEPROM_Device* dev, EEPROM_TraceHook hook, void* ctx)
+{
+	EEPROM_lock(dev);
+	dev->traceHook = hook;
+	dev->traceCtx = ctx;
+	EEPROM_unlock(dev);
 }
+#endif
@@ -9,6 +9,7 @@
 #define EEPROM_H_
 
 #include "stdint.h"
+#include "stdbool.h"
 #include "components.h"
 #include "spi_lld.h"
 
@@ -32,6 +33,227 @@
  */
 #define EEPROM_STATUS_BIT_WPEN	0x80
 
+/**
+ * @brief Enables the SPC5 hardware abstraction layer.
+ *
+ * When TRUE, @ref EEPROM_initDevice connects devices to the SPC5 @p spi_lld and
+ * @p pal_lld drivers. When FALSE, for example in host builds against a simulated
+ * device, every device must be given a HAL with @ref EEPROM_setHal, and the DMA and
+ * hardware chip select modes are not available.
+ */
+#ifndef EEPROM_USE_SPC5_HAL
+#define EEPROM_USE_SPC5_HAL		TRUE
+#endif
+
+/**
+ * @brief Largest write page size in bytes of all devices in use.
+ *
+ * Sizes the page buffers on the stack, the pageSize of every @ref EEPROM_Device
+ * must not exceed it.
+ */
+#ifndef EEPROM_MAX_PAGE_SIZE
+#define EEPROM_MAX_PAGE_SIZE	32
+#endif
+
+/**
+ * @brief Enables the RAM shadow cache of the memory array.
+ *
+ * When TRUE and the cache of a device is loaded with @ref EEPROM_cacheLoad, reads are
+ * served from RAM and writes only update RAM and mark the touched pages dirty. Dirty
+ * pages are written to the device by @ref EEPROM_flush or @ref EEPROM_flushAsync.
+ */
+#ifndef EEPROM_USE_CACHE
+#define EEPROM_USE_CACHE		FALSE
+#endif
+
+/**
+ * @brief Enables the DMA driven transfer path for range transfers.
+ *
+ * When TRUE, @ref EEPROM_readRange and @ref EEPROM_writeRange move their data with
+ * the @p spi_lld_send / @p spi_lld_receive / @p spi_lld_exchange block functions
+ * instead of polling every byte. The calling thread is suspended during a transfer
+ * and resumed by @ref EEPROM_dmaEndCallback, which must be set as @p end_cb in the
+ * SPIConfig.
+ */
+#ifndef EEPROM_USE_DMA
+#define EEPROM_USE_DMA			FALSE
+#endif
+
+/**
+ * @brief Minimum transfer length in bytes for using the DMA path.
+ *
+ * Shorter transfers stay on the polled path, where the DMA setup would cost
+ * more than it saves.
+ */
+#ifndef EEPROM_DMA_THRESHOLD
+#define EEPROM_DMA_THRESHOLD	8
+#endif
+
+/**
+ * @brief Number of SPI drivers that can use the DMA path at the same time.
+ *
+ * Devices on further drivers fall back to the polled path.
+ */
+#ifndef EEPROM_DMA_MAX_DRIVERS
+#define EEPROM_DMA_MAX_DRIVERS	2
+#endif
+
+/**
+ * @brief Longest read of the DMA path that is transferred as one exchange.
+ *
+ * Such reads send the command and receive the data with a single DMA setup, through
+ * a bounce buffer on the stack. Longer reads send the command and receive the data
+ * as two transfers.
+ */
+#ifndef EEPROM_DMA_READ_SPAN
+#define EEPROM_DMA_READ_SPAN	64
+#endif
+
+/**
+ * @brief Enables the hardware chip select burst mode.
+ *
+ * When TRUE, devices with a non zero @p pcsMask are selected by the DSPI peripheral
+ * chip select lines instead of a GPIO pad. Each transaction is pushed as one sequence
+ * of frames with the PUSHR CONT bit set, so the DSPI keeps the chip select asserted
+ * and applies the CS timing of the CTAR. The PCS pins must be routed to the DSPI and
+ * their inactive state set high in the MCR. The frames are pipelined through the
+ * DSPI FIFOs, and pairs of bytes may be sent as 16 bit frames, see @p ctas16.
+ */
+#ifndef EEPROM_USE_HW_CS
+#define EEPROM_USE_HW_CS		FALSE
+#endif
+
+/**
+ * @brief Frames the hardware chip select burst mode keeps in flight.
+ *
+ * Must not exceed the depth of the DSPI TX and RX FIFOs of the MCU.
+ */
+#ifndef EEPROM_DSPI_FIFO_DEPTH
+#define EEPROM_DSPI_FIFO_DEPTH	4
+#endif
+
+#if (EEPROM_USE_SPC5_HAL == FALSE) && ((EEPROM_USE_DMA == TRUE) || (EEPROM_USE_HW_CS == TRUE))
+#error "EEPROM_USE_DMA and EEPROM_USE_HW_CS require EEPROM_USE_SPC5_HAL"
+#endif
+
+/**
+ * @brief Enables the bus arbitration between threads.
+ *
+ * When TRUE, every function locks the OSAL mutex set with @ref EEPROM_setBusMutex
+ * while it accesses the device, so transactions of different threads never
+ * interleave. Threads waiting for the bus are queued by priority. The mutex is
+ * released while a function sleeps between status polls, so other devices on the
+ * bus remain accessible during a write cycle. Accesses to the busy device itself wait
+ * for the write cycle to complete, reads are served from the shadow cache if it is
+ * loaded.
+ */
+#ifndef EEPROM_USE_MUTUAL_EXCLUSION
+#define EEPROM_USE_MUTUAL_EXCLUSION	FALSE
+#endif
+
+/**
+ * @brief Enables the activity counters of the devices.
+ *
+ * When TRUE, every device counts its bus bytes, transactions, WREN instructions, page
+ * writes and status polls, and keeps the longest call of each blocking function, see
+ * @ref EEPROM_getStatistics. The latencies need the @p timeUs function of the HAL.
+ */
+#ifndef EEPROM_USE_STATISTICS
+#define EEPROM_USE_STATISTICS	FALSE
+#endif
+
+/**
+ * @brief Enables the transaction trace hook, see @ref EEPROM_setTrace.
+ */
+#ifndef EEPROM_USE_TRACE
+#define EEPROM_USE_TRACE		FALSE
+#endif
+
+#if (EEPROM_USE_SPC5_HAL == TRUE) && (EEPROM_USE_STATISTICS == TRUE)
+/**
+ * @brief Microsecond time of the SPC5 HAL, used for the latencies of the statistics.
+ *
+ * The system time has the resolution of the system tick, a free running timer such
+ * as the STM gives exact latencies.
+ */
+#ifndef EEPROM_TIME_US
+#define EEPROM_TIME_US()		((uint32_t)OSAL_ST2US(osalOsGetSystemTimeX()))
+#endif
+#endif
+
+/**
+ * @brief Default delay in microseconds after the first busy status poll of @ref EEPROM_wait.
+ *
+ * Both parts specify a maximum write cycle time (tWC) of 5 ms, the cycle rarely
+ * completes within the first millisecond.
+ */
+#ifndef EEPROM_WAIT_INITIAL_US
+#define EEPROM_WAIT_INITIAL_US	1000
+#endif
+
+/**
+ * @brief Default first poll interval in microseconds of @ref EEPROM_wait.
+ *
+ * The interval doubles after each busy poll up to @ref EEPROM_WAIT_MAX_POLL_US.
+ */
+#ifndef EEPROM_WAIT_MIN_POLL_US
+#define EEPROM_WAIT_MIN_POLL_US	50
+#endif
+
+/**
+ * @brief Default upper limit of the poll interval in microseconds of @ref EEPROM_wait.
+ */
+#ifndef EEPROM_WAIT_MAX_POLL_US
+#define EEPROM_WAIT_MAX_POLL_US	500
+#endif
+
+/**
+ * @brief Default timeout in microseconds of @ref EEPROM_wait, 0 waits forever.
+ */
+#ifndef EEPROM_WAIT_TIMEOUT_US
+#define EEPROM_WAIT_TIMEOUT_US	0
+#endif
+
+/**
+ * @brief Default gap in bytes that @ref EEPROM_readv reads through to merge two requests.
+ *
+ * Reading through a gap costs one SCK byte per gap byte, a separate READ costs the
+ * opcode, the address bytes and a chip select cycle.
+ */
+#ifndef EEPROM_READV_GAP
+#define EEPROM_READV_GAP		8
+#endif
+
+/**
+ * @brief Largest merged span of @ref EEPROM_readv, the size of its bounce buffer.
+ *
+ * Requests that do not fit are read on their own.
+ */
+#ifndef EEPROM_READV_SPAN
+#define EEPROM_READV_SPAN		64
+#endif
+
+/**
+ * @brief Requests that @ref EEPROM_readv sorts and merges at once.
+ *
+ * Longer request lists are processed in chunks of this size.
+ */
+#ifndef EEPROM_READV_MAX_IOV
+#define EEPROM_READV_MAX_IOV	16
+#endif
+
+#if EEPROM_READV_MAX_IOV > 256
+#error "EEPROM_READV_MAX_IOV must not exceed 256"
+#endif
+
+/**
+ * @brief Default number of times a page that fails its readback verification is
+ * written again.
+ */
+#ifndef EEPROM_VERIFY_RETRIES
+#define EEPROM_VERIFY_RETRIES	2
+#endif
+
 /**
  * @brief Block protection settings for EEPROM.
  */
@@ -43,6 +265,267 @@ typedef enum
 	BlockProtection_WholeMemory	= 3,	/**< 0x0000 - 0x0FFF*/
 }EEPROM_BlockProtection;
 
+/**
+ * @brief Supported EEPROM parts, selects the geometry set by @ref EEPROM_initDevice.
+ */
+typedef enum
+{
+	Part_AT25320A	= 0,	/**< 4096 bytes, 32 byte pages	*/
+	Part_M95040		= 1,	/**< 512 bytes, 16 byte pages	*/
+}EEPROM_Part;
+
+/**
+ * @brief Address formats of the READ and WRITE instructions.
+ */
+typedef enum
+{
+	AddressFormat_OneByteA8	= 0,	/**< One address byte, A8 in bit 3 of the opcode (M95040)	*/
+	AddressFormat_TwoByte	= 1,	/**< Two address bytes (AT25320A)							*/
+	AddressFormat_ThreeByte	= 2,	/**< Three address bytes (larger 25xxx parts)				*/
+}EEPROM_AddressFormat;
+
+/**
+ * @brief Result codes of EEPROM operations.
+ */
+typedef enum
+{
+	Result_Ok			= 0,	/**< Operation completed or started		*/
+	Result_Busy			= 1,	/**< Another operation is in progress		*/
+	Result_Timeout		= 2,	/**< The device did not become ready		*/
+	Result_CrcError		= 3,	/**< Stored data failed its check			*/
+	Result_VerifyError	= 4,	/**< A page did not read back as written	*/
+	Result_Protected	= 5,	/**< The range is write protected			*/
+	Result_OutOfRange	= 6,	/**< The range exceeds the memory array	*/
+}EEPROM_Result;
+
+/**
+ * @brief Readback verification of page writes.
+ */
+typedef enum
+{
+	VerifyMode_None		= 0,	/**< Pages are not read back						*/
+	VerifyMode_Compare	= 1,	/**< Each byte read back is compared with the data	*/
+	VerifyMode_Crc		= 2,	/**< The CRC-16 of the page read back is compared	*/
+}EEPROM_VerifyMode;
+
+/**
+ * @brief Blocking functions whose longest call is kept by the statistics.
+ */
+typedef enum
+{
+	Api_ReadRange			= 0,	/**< @ref EEPROM_readRange and @ref EEPROM_readByte	*/
+	Api_ReadRangeVerified	= 1,	/**< @ref EEPROM_readRangeVerified					*/
+	Api_Readv				= 2,	/**< @ref EEPROM_readv								*/
+	Api_WriteByte			= 3,	/**< @ref EEPROM_writeByte							*/
+	Api_WriteRange			= 4,	/**< @ref EEPROM_writeRange							*/
+	Api_WriteRangeDiff		= 5,	/**< @ref EEPROM_writeRangeDiff						*/
+	Api_Writev				= 6,	/**< @ref EEPROM_writev and @ref EEPROM_writeRangeCrc	*/
+	Api_WriteRangePipelined	= 7,	/**< @ref EEPROM_writeRangePipelined				*/
+	Api_Wait				= 8,	/**< @ref EEPROM_wait								*/
+	Api_Flush				= 9,	/**< @ref EEPROM_flush								*/
+	Api_ReadStatus			= 10,	/**< @ref EEPROM_readStatusReg						*/
+	Api_WriteStatus			= 11,	/**< @ref EEPROM_writeStatusReg						*/
+	Api_Count				= 12,	/**< Number of functions							*/
+}EEPROM_Api;
+
+/**
+ * @brief Activity counters of a device, see @ref EEPROM_USE_STATISTICS.
+ *
+ * The counters wrap around.
+ */
+typedef struct
+{
+	uint32_t spiBytes;			/**< Bytes exchanged on the bus, including opcodes	*/
+	uint32_t transactions;		/**< Chip select framed transactions				*/
+	uint32_t wrenCount;			/**< WREN instructions sent							*/
+	uint32_t pagesWritten;		/**< Page writes started							*/
+	uint32_t waitPolls;			/**< Status polls while waiting for a write cycle	*/
+	uint32_t waitUs;			/**< Time slept while waiting for a write cycle		*/
+	uint32_t maxLatencyUs[Api_Count];	/**< Longest call of each function, including
+											 the time waiting for the bus			*/
+}EEPROM_Statistics;
+
+/**
+ * @brief Events reported to the trace hook.
+ */
+typedef enum
+{
+	TraceEvent_Begin	= 0,	/**< The chip select is about to be asserted	*/
+	TraceEvent_End		= 1,	/**< The chip select has been released			*/
+}EEPROM_TraceEvent;
+
+typedef struct _EEPROM_DEVICE EEPROM_Device;
+
+/**
+ * @brief Trace hook called at the start and the end of every bus transaction.
+ *
+ * Runs with the bus locked, in the context of the calling thread, and must return
+ * quickly.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] event Start or end of the transaction.
+ * @param[in] opcode Instruction of the transaction.
+ * @param[in] length Bytes exchanged, including the instruction and the address, 0 at
+ *            TraceEvent_Begin.
+ * @param[in] ctx User pointer passed to @ref EEPROM_setTrace.
+ */
+typedef void (*EEPROM_TraceHook)(EEPROM_Device* dev, EEPROM_TraceEvent event, uint8_t opcode,
+								 uint32_t length, void* ctx);
+
+/**
+ * @brief Completion callback of asynchronous operations.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] result Result of the operation.
+ * @param[in] ctx User pointer passed when the operation was started.
+ */
+typedef void (*EEPROM_Callback)(EEPROM_Device* dev, EEPROM_Result result, void* ctx);
+
+/**
+ * @brief Page preparation hook of @ref EEPROM_writeRangePipelined.
+ *
+ * Produces the bytes written to one page from the source data, for example by packing,
+ * adding a CRC or encrypting them.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] addr Address of the page part in the EEPROM.
+ * @param[in] src Source data of the page part.
+ * @param[out] dst Bytes to write, @p length bytes.
+ * @param[in] length Length of the page part.
+ * @param[in] ctx User pointer passed to @ref EEPROM_writeRangePipelined.
+ *
+ * @return true to write the page part, false to skip it, for example if it is unchanged.
+ */
+typedef bool (*EEPROM_PagePrep)(EEPROM_Device* dev, uint32_t addr, const uint8_t* src, uint8_t* dst,
+								uint32_t length, void* ctx);
+
+/**
+ * @brief Hardware abstraction layer of a device.
+ *
+ * The driver frames every transaction with @p select and @p deselect and exchanges
+ * 8 bit frames in between. @p timeUs is only used with EEPROM_USE_STATISTICS.
+ */
+typedef struct
+{
+	uint8_t (*exchange)(EEPROM_Device* dev, uint8_t frame);	/**< Exchange one frame		*/
+	void (*select)(EEPROM_Device* dev);						/**< Assert the chip select		*/
+	void (*deselect)(EEPROM_Device* dev);					/**< Release the chip select	*/
+	void (*delayUs)(EEPROM_Device* dev, uint32_t us);		/**< Sleep or busy wait			*/
+	uint32_t (*timeUs)(EEPROM_Device* dev);					/**< Free running microsecond time
+																 of the statistics, may be NULL	*/
+}EEPROM_Hal;
+
+/**
+ * @brief Polling policy of @ref EEPROM_wait.
+ *
+ * The status register is polled once immediately. While the device is busy the next
+ * poll follows after @p initialDelayUs, then after @p minPollUs, doubling the interval
+ * up to @p maxPollUs.
+ */
+typedef struct
+{
+	uint32_t initialDelayUs;	/**< Delay after the first busy poll				*/
+	uint32_t minPollUs;			/**< First poll interval after the initial delay	*/
+	uint32_t maxPollUs;			/**< Upper limit of the poll interval				*/
+	uint32_t timeoutUs;			/**< Give up after this time, 0 waits forever		*/
+	bool continuousRead;		/**< Keep CS asserted and read the status register
+									 continuously instead of a transaction per poll,
+									 not supported in hardware chip select mode			*/
+}EEPROM_WaitPolicy;
+
+/**
+ * @brief One request of a scatter gather transfer.
+ */
+typedef struct
+{
+	uint32_t addr;			/**< Address in the EEPROM			*/
+	uint8_t* buf;			/**< Buffer of the caller			*/
+	uint32_t len;			/**< Number of bytes				*/
+}EEPROM_iovec;
+
+/**
+ * @brief State of a page split write, used internally by the driver.
+ */
+typedef struct
+{
+	EEPROM_Device* dev;		/**< Device being written				*/
+	uint32_t addr;			/**< Address of the next page to write	*/
+	uint8_t* data;			/**< Data of the next page to write		*/
+	uint32_t remaining;		/**< Bytes left to write				*/
+	EEPROM_Callback cb;		/**< Completion callback				*/
+	void* ctx;				/**< User pointer of the callback		*/
+	bool active;			/**< An asynchronous write is running	*/
+	EEPROM_Result result;	/**< Result passed to the callback		*/
+	uint32_t startAddr;		/**< Start address of the whole write	*/
+	uint32_t length;		/**< Length of the whole write			*/
+}EEPROM_WriteJob;
+
+/**
+ * @brief Descriptor of one EEPROM device.
+ *
+ * Set up by @ref EEPROM_initDevice and passed to every function. The geometry fields
+ * may be changed after initialization for other register compatible parts.
+ */
+struct _EEPROM_DEVICE
+{
+	const EEPROM_Hal* hal;		/**< Hardware abstraction layer							*/
+	void* halCtx;				/**< User pointer of the HAL							*/
+	SPIDriver* spip;			/**< SPI driver of the bus the device is connected to	*/
+	ioportid_t csPort;			/**< Port of the chip select pad						*/
+	uint8_t csPad;				/**< Chip select pad, active low						*/
+#if (EEPROM_USE_HW_CS == TRUE) || defined(__DOXYGEN__)
+	uint8_t pcsMask;			/**< DSPI PCS lines selecting the device, 0 uses the
+									 chip select pad										*/
+	uint8_t ctas;				/**< CTAR used for the transfers of the device			*/
+	uint8_t ctas16;				/**< CTAR configured like @p ctas with 16 bit frames,
+									 used for pairs of bytes if it differs from @p ctas	*/
+#endif
+	uint16_t pageSize;			/**< Write page size in bytes							*/
+	uint32_t capacity;			/**< Size of the memory array in bytes					*/
+	EEPROM_AddressFormat addressFormat;	/**< Address format of READ and WRITE			*/
+
+	EEPROM_WaitPolicy waitPolicy;	/**< Polling policy of @ref EEPROM_wait			*/
+	bool busy;						/**< A write cycle started by the driver may still
+										 be in progress									*/
+	uint32_t pendingAddr;			/**< Address of the page write in progress		*/
+	uint16_t pendingLength;			/**< Length of the page write in progress		*/
+	uint8_t pending[EEPROM_MAX_PAGE_SIZE];	/**< Data of the page write in progress	*/
+	EEPROM_VerifyMode verifyMode;	/**< Readback verification of page writes		*/
+	uint8_t verifyRetries;			/**< Rewrites of a page failing verification	*/
+	uint8_t verifyAttempts;			/**< Rewrites of the pending page so far		*/
+	bool verifyPending;				/**< The pending page is not verified yet		*/
+	uint16_t pendingCrc;			/**< CRC-16 of the pending page					*/
+	bool writeEnabled;				/**< The write enable latch is set				*/
+	uint8_t protection;				/**< BP and WPEN bits of the status register	*/
+	bool protectionValid;			/**< @p protection matches the device			*/
+#if (EEPROM_USE_MUTUAL_EXCLUSION == TRUE) || defined(__DOXYGEN__)
+	mutex_t* busMutex;				/**< Mutex shared by the devices of one bus		*/
+#endif
+	uint16_t readvGap;				/**< Largest gap @ref EEPROM_readv reads through,
+										 defaults to EEPROM_READV_GAP					*/
+	EEPROM_WriteJob job;			/**< Asynchronous write in progress				*/
+#if (EEPROM_USE_STATISTICS == TRUE) || defined(__DOXYGEN__)
+	EEPROM_Statistics stats;		/**< Activity counters							*/
+#endif
+#if (EEPROM_USE_TRACE == TRUE) || defined(__DOXYGEN__)
+	EEPROM_TraceHook traceHook;		/**< Transaction trace hook, may be NULL		*/
+	void* traceCtx;					/**< User pointer of the trace hook				*/
+#endif
+
+#if (EEPROM_USE_CACHE == TRUE) || defined(__DOXYGEN__)
+	uint8_t* cache;				/**< Shadow copy of the array, capacity bytes			*/
+	uint8_t* cacheDirty;		/**< Dirty bitmap, one bit per page						*/
+	bool cacheValid;			/**< The cache is loaded and in use						*/
+	EEPROM_Callback flushCb;	/**< Completion callback of @ref EEPROM_flushAsync		*/
+	void* flushCtx;				/**< User pointer of the flush callback					*/
+#endif
+};
+
+/**
+ * @brief Size in bytes of the dirty bitmap of the shadow cache.
+ */
+#define EEPROM_CACHE_DIRTY_SIZE(capacity, pageSize)	((((capacity) / (pageSize)) + 7) / 8)
+
 /**
  * @brief Structure representing the EEPROM status register.
  */
@@ -62,6 +545,7 @@ typedef struct _EEPROM_STAT_REG
 	}SR;
 }EEPROM_StatusRegister;
 
+#if (EEPROM_USE_SPC5_HAL == TRUE) || defined(__DOXYGEN__)
 /**
  * @brief Configures and activates the SPI peripheral.
  *
@@ -81,52 +565,122 @@ void EEPROM_startSpi(SPIDriver* spip, SPIConfig* pConfig);
  */
 void EEPROM_stopSpi(SPIDriver* spip);
 
+#if (EEPROM_USE_DMA == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief End of transfer callback of the DMA path.
+ *
+ * Must be set as @p end_cb in the SPIConfig passed to @ref EEPROM_startSpi. Called
+ * from the DMA interrupt, it resumes the thread waiting for the transfer.
+ *
+ * @param[in] spip Pointer to the SPIDriver structure.
+ *
+ * @return None.
+ */
+void EEPROM_dmaEndCallback(SPIDriver* spip);
+#endif
+#endif
+
+/**
+ * @brief Initialize an EEPROM device descriptor.
+ *
+ * This function sets the geometry of the given part, the default wait policy and
+ * deasserts the chip select. The SPI driver must be started separately with
+ * @ref EEPROM_startSpi, several devices may share one driver. The device uses the
+ * SPC5 HAL, without EEPROM_USE_SPC5_HAL a HAL must be set with @ref EEPROM_setHal.
+ *
+ * @param[out] dev Pointer to the EEPROM_Device structure to initialize.
+ * @param[in] spip Pointer to the SPIDriver structure of the bus.
+ * @param[in] csPort Port of the chip select pad.
+ * @param[in] csPad Chip select pad.
+ * @param[in] part The connected part.
+ *
+ * @return None.
+ */
+void EEPROM_initDevice(EEPROM_Device* dev, SPIDriver* spip, ioportid_t csPort, uint8_t csPad, EEPROM_Part part);
+
+#if (EEPROM_USE_MUTUAL_EXCLUSION == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief Set the mutex that arbitrates the bus of a device.
+ *
+ * All devices on one SPI driver must share the same mutex, initialized with
+ * @p osalMutexObjectInit. NULL disables the locking of the device.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] mutex Pointer to the bus mutex.
+ *
+ * @return None.
+ */
+void EEPROM_setBusMutex(EEPROM_Device* dev, mutex_t* mutex);
+#endif
+
+/**
+ * @brief Connect a device to a hardware abstraction layer.
+ *
+ * Replaces the SPC5 HAL set by @ref EEPROM_initDevice, for example with a simulated
+ * device. The chip select is deasserted.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] hal Pointer to the HAL, must stay valid.
+ * @param[in] ctx User pointer of the HAL, available as @p halCtx of the device.
+ *
+ * @return None.
+ */
+void EEPROM_setHal(EEPROM_Device* dev, const EEPROM_Hal* hal, void* ctx);
+
 /**
  * @brief Enable EEPROM write operations.
  *
  * This function sends the SPI command to enable write operations on the EEPROM.
+ * The writes of the driver send it themselves when the write enable latch is not
+ * set, so it is only needed to recover from a latch state the driver cannot know,
+ * such as after a reset of the EEPROM alone.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  *
  * @return None.
  */
-void EEPROM_enableWrite(SPIDriver* spip);
+void EEPROM_enableWrite(EEPROM_Device* dev);
 
 /**
  * @brief Disable EEPROM write operations.
  *
  * This function sends the SPI command to disable write operations on the M95040 EEPROM.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  *
  * @return None.
  */
-void EEPROM_disableWrite(SPIDriver* spip);
+void EEPROM_disableWrite(EEPROM_Device* dev);
 
 /**
  * @brief Read the EEPROM status register.
  *
  * This function sends the SPI command to read the status register of the EEPROM
- * and returns the value read.
+ * and returns the value read. The BP and WPEN bits are kept in the descriptor, so
+ * the writes can check the block protection without reading the status register.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  *
  * @return The value read from the status register.
  */
-uint8_t EEPROM_readStatusReg(SPIDriver* spip);
+uint8_t EEPROM_readStatusReg(EEPROM_Device* dev);
 
 
 /**
  * @brief Write to the EEPROM status register.
  *
- * This function sends the SPI command and data to write to the status register of the EEPROM.
+ * This function sends the SPI command and data to write to the status register of the EEPROM,
+ * enabling writes first if needed. A page write in progress is completed and verified
+ * first, if it fails the status register is not written. The block protection kept in
+ * the descriptor is read again before the next write.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  * @param[in] cmd The data to be written to the status register.
  *
- * @return None.
+ * @return Result_Ok, or the error of the previous page write: Result_Timeout or
+ *         Result_VerifyError.
  */
-void EEPROM_writeStatusReg(SPIDriver* spip, uint8_t cmd);
+EEPROM_Result EEPROM_writeStatusReg(EEPROM_Device* dev, uint8_t cmd);
 
 /**
  * @brief Read a byte from the EEPROM at the specified address.
@@ -134,66 +688,447 @@ void EEPROM_writeStatusReg(SPIDriver* spip, uint8_t cmd);
  * This function sends the SPI command and address to read a byte from the EEPROM
  * at the specified address.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  * @param[in] addr The address from which to read the byte.
  *
  * @return The byte read from the EEPROM.
  */
-uint8_t EEPROM_readByte(SPIDriver* spip, uint16_t addr);
+uint8_t EEPROM_readByte(EEPROM_Device* dev, uint32_t addr);
 
 /**
  * @brief Write a byte to the EEPROM at the specified address.
  *
- * This function writes a byte of data to the EEPROM at the given address.
+ * This function writes a byte of data to the EEPROM at the given address, enabling
+ * writes first if needed. If the shadow cache is loaded only the cache is updated.
+ * The byte is dropped if it lies in a write protected page, or if the device does not
+ * become ready within the timeout of the wait policy to read the block protection.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  * @param[in] addr The address where the data will be written.
  * @param[in] data The byte of data to be written.
  *
  * @return None.
  */
-void EEPROM_writeByte(SPIDriver* spip, uint16_t addr, uint8_t data);
+void EEPROM_writeByte(EEPROM_Device* dev, uint32_t addr, uint8_t data);
 
 /**
  * @brief Read a range of bytes from the EEPROM starting from the specified address.
  *
  * This function sends the SPI command and starting address to read a range of bytes from
- * the EEPROM and stores the data in the provided data buffer.
+ * the EEPROM and stores the data in the provided data buffer. During a write cycle, a
+ * range within the page being written is answered from the data of that write without
+ * waiting. Other ranges wait for the cycle to complete.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  * @param[in] startAddr The starting address from where to read the data.
  * @param[out] data Pointer to the data buffer where the read data will be stored.
  * @param[in] length The number of bytes to read.
  *
  * @return None.
  */
-void EEPROM_readRange(SPIDriver* spip, uint16_t startAddr, uint8_t* data, uint32_t length);
+void EEPROM_readRange(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Read a range of bytes after checking it against the capacity of the device.
+ *
+ * Same as @ref EEPROM_readRange, but a range that does not lie within the memory
+ * array is rejected instead of wrapping around at its end.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The starting address from where to read the data.
+ * @param[out] data Pointer to the data buffer where the read data will be stored.
+ * @param[in] length The number of bytes to read.
+ *
+ * @return Result_Ok, or Result_OutOfRange without a bus transfer.
+ */
+EEPROM_Result EEPROM_readRangeChecked(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Read a range of a ring buffer that spans the whole memory array.
+ *
+ * The start address is taken modulo the capacity. A range that runs past the end of
+ * the array continues at address 0, it is read as two requests of @ref EEPROM_readv
+ * instead of relying on the address rollover of the part.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The starting address from where to read the data.
+ * @param[out] data Pointer to the data buffer where the read data will be stored.
+ * @param[in] length The number of bytes to read, at most the capacity.
+ *
+ * @return Result_Ok, or Result_OutOfRange without a bus transfer.
+ */
+EEPROM_Result EEPROM_readRangeWrapped(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Read several ranges of bytes from the EEPROM.
+ *
+ * The requests are sorted by address. Requests that overlap or are separated by at
+ * most @p readvGap bytes are merged into one READ, which reads through the gaps into
+ * a bounce buffer of EEPROM_READV_SPAN bytes and scatters the data to the buffers of
+ * the requests. Requests longer than the bounce buffer are read on their own.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] v Array of requests, the data is stored to their buffers.
+ * @param[in] n Number of requests.
+ *
+ * @return None.
+ */
+void EEPROM_readv(EEPROM_Device* dev, const EEPROM_iovec* v, uint32_t n);
+
+/**
+ * @brief Read a record and check the CRC-16 stored after it.
+ *
+ * The record is @p length bytes followed by EEPROM_CRC16_SIZE bytes of CRC, as written
+ * by @ref EEPROM_writeRangeCrc. The CRC is updated as each byte arrives from the bus
+ * and the stored CRC is read in the same READ, so the data is not traversed again.
+ * Transfers through DMA or the hardware chip select burst are checked over the
+ * received buffer and read the stored CRC with a second READ.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The address of the record.
+ * @param[out] data Pointer to the data buffer where the record will be stored.
+ * @param[in] length The length of the record without the CRC.
+ *
+ * @return Result_Ok, or Result_CrcError if the data does not match the stored CRC.
+ */
+EEPROM_Result EEPROM_readRangeVerified(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
 
 /**
  * @brief Write a range of bytes to the EEPROM starting from the specified address.
  *
- * This function sends the SPI command, starting address, and data to write the data range
- * to the EEPROM.
+ * This function splits the range on page boundaries and writes each
+ * part with its own WRITE command. WREN is sent before a page only if the write
+ * enable latch is not set, and the function waits for the previous page to complete
+ * before starting the next one. The last page is still being written when the
+ * function returns. The next access waits for that write cycle by itself, call
+ * @ref EEPROM_wait only to wait for it, or for its verification result, at a point of
+ * your choice. If the shadow cache is loaded only the cache is updated.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The starting address where the data will be written.
+ * @param[in] data Pointer to the data buffer containing the data to be written.
+ * @param[in] length The number of bytes to write.
+ *
+ * @return Result_Ok, Result_Protected if the range touches a write protected page,
+ *         Result_Timeout if waiting for a page to complete timed out, or
+ *         Result_VerifyError if a page failed its readback verification.
+ */
+EEPROM_Result EEPROM_writeRange(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Write a range of bytes after checking it against the capacity of the device.
+ *
+ * Same as @ref EEPROM_writeRange, but a range that does not lie within the memory
+ * array is rejected instead of wrapping around at its end.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The starting address where the data will be written.
+ * @param[in] data Pointer to the data buffer containing the data to be written.
+ * @param[in] length The number of bytes to write.
+ *
+ * @return Result_OutOfRange without a bus transfer, or the result of
+ *         @ref EEPROM_writeRange.
+ */
+EEPROM_Result EEPROM_writeRangeChecked(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Write a record followed by its CRC-16.
+ *
+ * The record and the EEPROM_CRC16_SIZE bytes of CRC are written together page by page
+ * as with @ref EEPROM_writev, read it back with @ref EEPROM_readRangeVerified.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The address of the record.
+ * @param[in] data Pointer to the record.
+ * @param[in] length The length of the record without the CRC.
+ *
+ * @return Result_Ok, Result_Protected if the range touches a write protected page,
+ *         Result_Timeout if waiting for a page to complete timed out, or
+ *         Result_VerifyError if a page failed its readback verification.
+ */
+EEPROM_Result EEPROM_writeRangeCrc(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Write a range, preparing each page during the write cycle of the previous one.
+ *
+ * The range is split on page boundaries as with @ref EEPROM_writeRange. Each part is
+ * passed through @p prep into a page buffer. The next part is prepared right after a
+ * page write has been started, so the preparation overlaps the write cycle and the
+ * next page goes out as soon as the device is ready. The copy that the descriptor
+ * keeps of the page write in progress acts as the second buffer. The bus is unlocked
+ * while @p prep runs.
+ *
+ * If the shadow cache is loaded the prepared pages only update the cache.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The starting address where the data will be written.
+ * @param[in] data Pointer to the source data.
+ * @param[in] length The number of bytes to write.
+ * @param[in] prep Page preparation hook, NULL writes the data unchanged.
+ * @param[in] ctx User pointer passed to @p prep.
+ *
+ * @return Result_Ok, Result_Protected if the range touches a write protected page,
+ *         Result_Timeout if waiting for a page to complete timed out, or
+ *         Result_VerifyError if a page failed its readback verification.
+ */
+EEPROM_Result EEPROM_writeRangePipelined(EEPROM_Device* dev, uint32_t startAddr, const uint8_t* data,
+										 uint32_t length, EEPROM_PagePrep prep, void* ctx);
+
+/**
+ * @brief Write only the changed bytes of a range to the EEPROM.
+ *
+ * This function compares the range page by page with the current content and writes
+ * only the span between the first and the last changed byte of each page. Pages that
+ * are unchanged are skipped and cost neither a write cycle nor endurance. The
+ * current content is read from the device, or taken from the shadow cache if it is
+ * loaded, in which case only changed pages are marked dirty.
+ *
+ * WREN is sent before a page only if the write enable latch is not set. As with
+ * @ref EEPROM_writeRange the last page is still being written when the function
+ * returns, and the next access waits for it by itself.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] startAddr The starting address where the data will be written.
+ * @param[in] data Pointer to the data buffer containing the data to be written.
+ * @param[in] length The number of bytes to write.
+ *
+ * @return Result_Ok, Result_Protected if a page is write protected, Result_Timeout if
+ *         waiting for the device timed out, or Result_VerifyError if a page failed
+ *         its readback verification.
+ */
+EEPROM_Result EEPROM_writeRangeDiff(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Write several ranges of bytes to the EEPROM.
+ *
+ * The requests are grouped by page. For every touched page the requests are merged
+ * into one span from the first to the last written byte, bytes in between that no
+ * request writes are read back first. Each touched page then costs one WREN, WRITE
+ * and write cycle, instead of one per request. Where requests overlap, the later one
+ * in @p v wins. With the cache loaded the requests only update the cache.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] v Array of requests, the data is taken from their buffers.
+ * @param[in] n Number of requests.
+ *
+ * @return Result_Ok, Result_Protected if the range touches a write protected page,
+ *         Result_Timeout if waiting for a page to complete timed out, or
+ *         Result_VerifyError if a page failed its readback verification.
+ */
+EEPROM_Result EEPROM_writev(EEPROM_Device* dev, const EEPROM_iovec* v, uint32_t n);
+
+/**
+ * @brief Start writing a range of bytes to the EEPROM without blocking.
+ *
+ * This function starts the first page of the range and returns. The remaining pages
+ * are written by @ref EEPROM_poll or @ref EEPROM_asyncPoll, which must be called
+ * periodically from a thread or the super loop, not from an ISR or a virtual timer
+ * callback. @p cb is called once the last page has been committed, in the context
+ * of the poll.
+ * The data buffer must stay valid until then, and the EEPROM must not be accessed
+ * by other functions while the write is in progress. If the shadow cache is loaded
+ * it is updated as well, the write always goes to the device.
+ *
+ * The first page is only started if the device is ready, otherwise it is started
+ * by a later @ref EEPROM_asyncPoll. For an empty range @p cb may be called before
+ * the function returns. With readback verification enabled the callback receives
+ * Result_VerifyError if a page still failed it after all rewrites, the remaining
+ * pages are not written then.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
  * @param[in] startAddr The starting address where the data will be written.
  * @param[in] data Pointer to the data buffer containing the data to be written.
  * @param[in] length The number of bytes to write.
+ * @param[in] cb Completion callback, may be NULL.
+ * @param[in] ctx User pointer passed to @p cb.
+ *
+ * @return Result_Ok if the write was started, Result_Busy if another asynchronous
+ *         write is still in progress or if the block protection must be read again
+ *         and the device is still in a write cycle, Result_Protected if the range
+ *         touches a write protected page. The function never waits for the device.
+ */
+EEPROM_Result EEPROM_writeRangeAsync(EEPROM_Device* dev, uint32_t startAddr, uint8_t* data, uint32_t length,
+									 EEPROM_Callback cb, void* ctx);
+
+/**
+ * @brief Advance the work of a device by one step without blocking.
+ *
+ * Each call performs at most one status register read and one page write, or one
+ * readback verification, and never sleeps, so it can be called from the super loop of
+ * a bare metal system. It drives the write started by @ref EEPROM_writeRangeAsync and
+ * @ref EEPROM_flushAsync: if the current page is complete it starts the next one, or
+ * calls the completion callback after the last page. Without an asynchronous write
+ * it completes the write cycle left by a blocking write, so polling until the result
+ * is not Result_Busy replaces @ref EEPROM_wait.
+ *
+ * Must be called from a thread or the super loop. With EEPROM_USE_MUTUAL_EXCLUSION it
+ * locks the bus mutex and may wait for another thread, so it is not allowed in an ISR
+ * or a virtual timer callback. No function of the driver is I-class.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ *
+ * @return Result_Busy while work is left, otherwise Result_Ok, or Result_VerifyError
+ *         if a page failed its readback verification.
+ */
+EEPROM_Result EEPROM_poll(EEPROM_Device* dev);
+
+/**
+ * @brief Advance the asynchronous write started by @ref EEPROM_writeRangeAsync.
+ *
+ * Same as @ref EEPROM_poll, with the same calling context: a thread or the super
+ * loop, never an ISR or a virtual timer callback.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ *
+ * @return true while the write, or a write cycle of the device, is still in progress.
+ */
+bool EEPROM_asyncPoll(EEPROM_Device* dev);
+
+#if (EEPROM_USE_CACHE == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief Load the whole memory array into the shadow cache.
+ *
+ * Reads are served from the cache and writes are recorded in it from now on.
+ * Pending dirty pages are discarded.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] cache Buffer of capacity bytes for the shadow copy.
+ * @param[in] dirty Buffer of @ref EEPROM_CACHE_DIRTY_SIZE bytes for the dirty bitmap.
  *
  * @return None.
  */
-void EEPROM_writeRange(SPIDriver* spip, uint16_t startAddr, uint8_t* data, uint32_t length);
+void EEPROM_cacheLoad(EEPROM_Device* dev, uint8_t* cache, uint8_t* dirty);
+
+/**
+ * @brief Stop using the shadow cache.
+ *
+ * Dirty pages that were not flushed are lost, accesses go to the device again.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ *
+ * @return None.
+ */
+void EEPROM_cacheInvalidate(EEPROM_Device* dev);
+
+/**
+ * @brief Write all dirty pages of the shadow cache to the device.
+ *
+ * Adjacent dirty pages are written as one page split range. The function returns
+ * after the last page has been committed.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ *
+ * @return Result_Ok, Result_Protected if a page is write protected, Result_Timeout if
+ *         waiting for the device timed out, or Result_VerifyError if a page failed
+ *         its readback verification.
+ */
+EEPROM_Result EEPROM_flush(EEPROM_Device* dev);
+
+/**
+ * @brief Write all dirty pages of the shadow cache to the device in the background.
+ *
+ * The pages are written as asynchronous writes, @ref EEPROM_asyncPoll must be called
+ * periodically. @p cb is called once all dirty pages have been committed. Pages that
+ * are written to the cache during the flush stay dirty.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] cb Completion callback, may be NULL.
+ * @param[in] ctx User pointer passed to @p cb.
+ *
+ * @return Result_Ok if the flush was started, Result_Busy if an asynchronous write
+ *         is still in progress or if the block protection must be read again and
+ *         the device is still in a write cycle. The function never waits for the
+ *         device.
+ */
+EEPROM_Result EEPROM_flushAsync(EEPROM_Device* dev, EEPROM_Callback cb, void* ctx);
+#endif
 
 /**
  * @brief Wait for the EEPROM's write operation to complete.
  *
- * This function continuously reads the status register of the EEPROM and waits
- * until the <span style="text-decoration: overline;">RDY</span> bit becomes 0, indicating that the write operation is complete.
+ * This function reads the status register of the EEPROM according to the wait policy
+ * and waits until the <span style="text-decoration: overline;">RDY</span> bit becomes 0, indicating that the write operation is complete.
  *
- * @param[in] spip Pointer to the SPIDriver structure.
+ * With readback verification enabled the last page written is verified, and written
+ * again if it does not match.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ *
+ * @return Result_Ok, Result_Timeout if the policy timeout elapsed first, or
+ *         Result_VerifyError if the last page did not read back as written.
+ */
+EEPROM_Result EEPROM_wait(EEPROM_Device* dev);
+
+/**
+ * @brief Set the polling policy of @ref EEPROM_wait.
+ *
+ * The default policy is built from the EEPROM_WAIT_* settings. The timeout is counted
+ * from the delays between polls, the duration of the polls themselves is not included.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] policy Pointer to the new policy, copied by the function.
+ *
+ * @return None.
+ */
+void EEPROM_setWaitPolicy(EEPROM_Device* dev, const EEPROM_WaitPolicy* policy);
+
+/**
+ * @brief Set the readback verification of page writes.
+ *
+ * Every page written to the device is read back once its write cycle has completed,
+ * before the next access to the device. Only the bytes of the page write are read,
+ * and they are checked against the copy of the page write kept in the descriptor
+ * byte by byte as they arrive, or through the CRC-16 of the page. A page that does
+ * not match is written again up to @p retries times, other pages are not affected.
+ * Writes then return Result_VerifyError if a page still does not match.
+ *
+ * Verification is off after @ref EEPROM_initDevice.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] mode Verification mode.
+ * @param[in] retries Number of rewrites of a failing page, EEPROM_VERIFY_RETRIES by
+ *            default.
+ *
+ * @return None.
+ */
+void EEPROM_setVerify(EEPROM_Device* dev, EEPROM_VerifyMode mode, uint8_t retries);
+
+#if (EEPROM_USE_STATISTICS == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief Read the activity counters of a device.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[out] stats Copy of the counters.
+ *
+ * @return None.
+ */
+void EEPROM_getStatistics(EEPROM_Device* dev, EEPROM_Statistics* stats);
+
+/**
+ * @brief Clear the activity counters and the latencies of a device.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ *
+ * @return None.
+ */
+void EEPROM_resetStatistics(EEPROM_Device* dev);
+#endif
+
+#if (EEPROM_USE_TRACE == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief Set the trace hook of a device.
+ *
+ * The hook is called before the chip select of a transaction is asserted and after it
+ * is released, so a tracer can attribute the bus time to the calling thread. The
+ * hooks of the devices of one bus never overlap when the bus mutex is used.
+ *
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] hook Trace hook, NULL disables tracing.
+ * @param[in] ctx User pointer passed to the hook.
  *
  * @return None.
  */
-void EEPROM_wait(SPIDriver* spip);
+void EEPROM_setTrace(EEPROM_Device* dev, EEPROM_TraceHook hook, void* ctx);
+#endif
 
 #endif /* EEPROM_H_ */
@@ -0,0 +1,181 @@
+/**
+ * @file EEPROM_atomic.c
+ *
+ * @brief Power fail safe record with two copies on top of the EEPROM driver.
+ *
+ * @details The header of a copy is written in its own page, after the data of the
+ * copy is committed, so the header page write is the commit point.
+ */
+
+#include "EEPROM_atomic.h"
+#include "EEPROM_crc.h"
+
+#define EEPROM_ATOMIC_LENGTH_OFFSET		4
+#define EEPROM_ATOMIC_DATA_CRC_OFFSET	6
+#define EEPROM_ATOMIC_CRC_OFFSET		8
+
+/**
+ * @brief Decoded header of a copy.
+ */
+typedef struct
+{
+	uint32_t seq;
+	uint16_t length;
+	uint16_t dataCrc;
+}EEPROM_AtomicHeader;
+
+static uint32_t EEPROM_atomicDataAddr(const EEPROM_Atomic* rec, uint32_t copy)
+{
+	return (rec->copyAddr[copy] + rec->dev->pageSize);
+}
+
+static bool EEPROM_atomicParseHeader(const EEPROM_Atomic* rec, const uint8_t* raw, EEPROM_AtomicHeader* header)
+{
+	uint16_t crc = ((uint16_t)raw[EEPROM_ATOMIC_CRC_OFFSET] << 8) | raw[EEPROM_ATOMIC_CRC_OFFSET + 1];
+
+	if (EEPROM_crc16(EEPROM_CRC16_INIT, raw, EEPROM_ATOMIC_CRC_OFFSET) != crc)
+	{
+		return false;
+	}
+
+	header->seq = ((uint32_t)raw[0] << 24) | ((uint32_t)raw[1] << 16) | ((uint32_t)raw[2] << 8) | raw[3];
+	header->length = ((uint16_t)raw[EEPROM_ATOMIC_LENGTH_OFFSET] << 8) | raw[EEPROM_ATOMIC_LENGTH_OFFSET + 1];
+	header->dataCrc = ((uint16_t)raw[EEPROM_ATOMIC_DATA_CRC_OFFSET] << 8) | raw[EEPROM_ATOMIC_DATA_CRC_OFFSET + 1];
+	return (header->length <= rec->maxLength);
+}
+
+/**
+ * @brief Write and commit a range, also when the shadow cache is loaded.
+ */
+static EEPROM_Result EEPROM_atomicWrite(EEPROM_Atomic* rec, uint32_t addr, uint8_t* data, uint32_t length)
+{
+	EEPROM_Result result = EEPROM_writeRange(rec->dev, addr, data, length);
+
+#if EEPROM_USE_CACHE == TRUE
+	// the data must reach the device before the header
+	if ((result == Result_Ok) && rec->dev->cacheValid)
+	{
+		result = EEPROM_flush(rec->dev);
+	}
+#endif
+	return result;
+}
+
+bool EEPROM_atomicInit(EEPROM_Atomic* rec, EEPROM_Device* dev, uint32_t baseAddr, uint16_t maxLength)
+{
+	uint32_t size = EEPROM_ATOMIC_SIZE(maxLength, dev->pageSize);
+
+	rec->dev = dev;
+	rec->maxLength = maxLength;
+	rec->active = -1;
+	rec->seq = 0;
+	rec->length = 0;
+	rec->copyAddr[0] = baseAddr;
+	rec->copyAddr[1] = baseAddr + size / 2;
+
+	return (((baseAddr % dev->pageSize) == 0) && (maxLength > 0) && (baseAddr + size <= dev->capacity));
+}
+
+bool EEPROM_atomicMount(EEPROM_Atomic* rec)
+{
+	uint8_t raw[2][EEPROM_ATOMIC_HEADER_SIZE];
+	EEPROM_iovec v[2] =
+	{
+		{rec->copyAddr[0], raw[0], EEPROM_ATOMIC_HEADER_SIZE},
+		{rec->copyAddr[1], raw[1], EEPROM_ATOMIC_HEADER_SIZE},
+	};
+
+	rec->active = -1;
+	EEPROM_readv(rec->dev, v, 2);
+
+	for (uint32_t copy = 0; copy < 2; copy++)
+	{
+		EEPROM_AtomicHeader header;
+		// serial number comparison, the sequence may wrap around
+		if (EEPROM_atomicParseHeader(rec, raw[copy], &header) &&
+			((rec->active < 0) || ((int32_t)(header.seq - rec->seq) > 0)))
+		{
+			rec->active = copy;
+			rec->seq = header.seq;
+			rec->length = header.length;
+		}
+	}
+	return (rec->active >= 0);
+}
+
+EEPROM_Result EEPROM_atomicRead(EEPROM_Atomic* rec, uint8_t* data, uint16_t* length)
+{
+	if (rec->active < 0)
+	{
+		return Result_CrcError;
+	}
+
+	// the newest copy first, the other one if its data is damaged
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		uint32_t copy = (i == 0) ? (uint32_t)rec->active : (uint32_t)(1 - rec->active);
+		uint8_t raw[EEPROM_ATOMIC_HEADER_SIZE];
+		EEPROM_AtomicHeader header;
+
+		EEPROM_readRange(rec->dev, rec->copyAddr[copy], raw, sizeof(raw));
+		if (!EEPROM_atomicParseHeader(rec, raw, &header))
+		{
+			continue;
+		}
+
+		EEPROM_readRange(rec->dev, EEPROM_atomicDataAddr(rec, copy), data, header.length);
+		if (EEPROM_crc16(EEPROM_CRC16_INIT, data, header.length) == header.dataCrc)
+		{
+			*length = header.length;
+			return Result_Ok;
+		}
+	}
+	return Result_CrcError;
+}
+
+EEPROM_Result EEPROM_atomicCommit(EEPROM_Atomic* rec, uint8_t* data, uint16_t length)
+{
+	uint32_t target = (rec->active == 0) ? 1 : 0;
+	uint32_t seq = (rec->active < 0) ? 0 : rec->seq + 1;
+	uint8_t raw[EEPROM_ATOMIC_HEADER_SIZE];
+	uint16_t dataCrc;
+	uint16_t crc;
+	EEPROM_Result result;
+
+	if (length > rec->maxLength)
+	{
+		return Result_OutOfRange;
+	}
+	dataCrc = EEPROM_crc16(EEPROM_CRC16_INIT, data, length);
+
+	result = EEPROM_atomicWrite(rec, EEPROM_atomicDataAddr(rec, target), data, length);
+	if (result != Result_Ok)
+	{
+		return result;
+	}
+
+	raw[0] = seq >> 24;
+	raw[1] = seq >> 16;
+	raw[2] = seq >> 8;
+	raw[3] = seq;
+	raw[EEPROM_ATOMIC_LENGTH_OFFSET] = length >> 8;
+	raw[EEPROM_ATOMIC_LENGTH_OFFSET + 1] = length;
+	raw[EEPROM_ATOMIC_DATA_CRC_OFFSET] = dataCrc >> 8;
+	raw[EEPROM_ATOMIC_DATA_CRC_OFFSET + 1] = dataCrc;
+	crc = EEPROM_crc16(EEPROM_CRC16_INIT, raw, EEPROM_ATOMIC_CRC_OFFSET);
+	raw[EEPROM_ATOMIC_CRC_OFFSET] = crc >> 8;
+	raw[EEPROM_ATOMIC_CRC_OFFSET + 1] = crc;
+
+	result = EEPROM_atomicWrite(rec, rec->copyAddr[target], raw, sizeof(raw));
+	if (result == Result_Ok)
+	{
+		result = EEPROM_wait(rec->dev);
+	}
+	if (result == Result_Ok)
+	{
+		rec->active = target;
+		rec->seq = seq;
+		rec->length = length;
+	}
+	return result;
+}
@@ -0,0 +1,103 @@
+/*
+ * EEPROM_atomic.h
+ *
+ *  Power fail safe record with two copies on top of the EEPROM driver.
+ */
+
+#ifndef EEPROM_ATOMIC_H_
+#define EEPROM_ATOMIC_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief Size of the header page content of a copy.
+ *
+ * The header holds the 32 bit sequence number, the data length, the CRC-16 of the
+ * data and the CRC-16 of the first eight header bytes.
+ */
+#define EEPROM_ATOMIC_HEADER_SIZE	10
+
+/**
+ * @brief Size in bytes of the area of a record with both copies.
+ *
+ * Each copy takes one header page followed by the pages of the data.
+ */
+#define EEPROM_ATOMIC_SIZE(maxLength, pageSize)	\
+	(2 * ((pageSize) + ((((maxLength) + (pageSize) - 1) / (pageSize)) * (pageSize))))
+
+/**
+ * @brief State of a power fail safe record.
+ *
+ * The record has two copies, each consisting of a header page and the data pages.
+ * A commit writes the data to the inactive copy and then its header with the next
+ * sequence number. An interrupted commit leaves the header of the inactive copy
+ * older or invalid, so the previous content stays the newest valid one.
+ */
+typedef struct
+{
+	EEPROM_Device* dev;		/**< Device holding the record						*/
+	uint32_t copyAddr[2];	/**< Address of the header page of each copy		*/
+	uint16_t maxLength;		/**< Largest data length							*/
+	int8_t active;			/**< Copy holding the newest data, -1 if none		*/
+	uint32_t seq;			/**< Sequence number of the active copy				*/
+	uint16_t length;		/**< Data length of the active copy					*/
+}EEPROM_Atomic;
+
+/**
+ * @brief Initialize a power fail safe record.
+ *
+ * The record occupies EEPROM_ATOMIC_SIZE(maxLength, pageSize) bytes at @p baseAddr.
+ *
+ * @param[out] rec Pointer to the record.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] baseAddr Address of the record, must be page aligned.
+ * @param[in] maxLength Largest data length.
+ *
+ * @return true if the record fits the device.
+ */
+bool EEPROM_atomicInit(EEPROM_Atomic* rec, EEPROM_Device* dev, uint32_t baseAddr, uint16_t maxLength);
+
+/**
+ * @brief Find the newest copy of the record.
+ *
+ * This function reads the two headers only and selects the valid one with the
+ * higher sequence number, so it takes constant time.
+ *
+ * @param[in,out] rec Pointer to the record.
+ *
+ * @return true if a valid copy was found.
+ */
+bool EEPROM_atomicMount(EEPROM_Atomic* rec);
+
+/**
+ * @brief Read the data of the record.
+ *
+ * The data of the active copy is checked against the CRC of its header. If it does
+ * not match, the other copy is used if it is valid.
+ *
+ * @param[in,out] rec Pointer to the record.
+ * @param[out] data Buffer of maxLength bytes.
+ * @param[out] length Length of the data read.
+ *
+ * @return Result_Ok, or Result_CrcError if no copy holds valid data.
+ */
+EEPROM_Result EEPROM_atomicRead(EEPROM_Atomic* rec, uint8_t* data, uint16_t* length);
+
+/**
+ * @brief Replace the data of the record.
+ *
+ * The data is written to the inactive copy, followed by its header. The function
+ * returns once both are committed, with the shadow cache loaded the writes are
+ * flushed in this order.
+ *
+ * @param[in,out] rec Pointer to the record.
+ * @param[in] data Pointer to the data.
+ * @param[in] length Data length, at most maxLength.
+ *
+ * @return Result_Ok, Result_Timeout if waiting for the device timed out, or
+ *         Result_OutOfRange if @p length exceeds maxLength, neither copy is
+ *         touched then.
+ */
+EEPROM_Result EEPROM_atomicCommit(EEPROM_Atomic* rec, uint8_t* data, uint16_t length);
+
+#endif /* EEPROM_ATOMIC_H_ */
@@ -0,0 +1,65 @@
+/*
+ * EEPROM_crc.h
+ *
+ *  CRC calculation for data stored in the EEPROM.
+ */
+
+#ifndef EEPROM_CRC_H_
+#define EEPROM_CRC_H_
+
+#include "stdint.h"
+
+/**
+ * @brief Initial value of @ref EEPROM_crc16.
+ */
+#define EEPROM_CRC16_INIT		0xFFFF
+
+/**
+ * @brief Initial value of @ref EEPROM_crc32.
+ */
+#define EEPROM_CRC32_INIT		0x00000000UL
+
+/**
+ * @brief Size of the CRC-16 stored after a record, most significant byte first.
+ *
+ * The CRC-16 over a record followed by its stored CRC is 0.
+ */
+#define EEPROM_CRC16_SIZE		2
+
+extern const uint16_t EEPROM_crc16Table[256];
+
+/**
+ * @brief Update a CRC-16 with one byte.
+ */
+#define EEPROM_CRC16_UPDATE(crc, byte)	\
+	((uint16_t)(((crc) << 8) ^ EEPROM_crc16Table[(((crc) >> 8) ^ (byte)) & 0xFF]))
+
+/**
+ * @brief Update a CRC-16/CCITT-FALSE (polynomial 0x1021, no reflection, no final XOR).
+ *
+ * Start with @ref EEPROM_CRC16_INIT, larger blocks may be processed in several calls.
+ *
+ * @param[in] crc CRC of the preceding bytes.
+ * @param[in] data Pointer to the data.
+ * @param[in] length Number of bytes.
+ *
+ * @return The updated CRC.
+ */
+uint16_t EEPROM_crc16(uint16_t crc, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Update a CRC-32 (ISO-HDLC, the CRC of zlib and Ethernet).
+ *
+ * Start with @ref EEPROM_CRC32_INIT, larger blocks may be processed in several calls.
+ * Four bytes are processed per step, which suits checks of large buffered blocks such
+ * as a loaded shadow cache.
+ *
+ * @param[in] crc CRC of the preceding bytes.
+ * @param[in] data Pointer to the data.
+ * @param[in] length Number of bytes.
+ *
+ * @return The updated CRC.
+ */
+uint32_t EEPROM_crc32(uint32_t crc, const uint8_t* data, uint32_t length);
+
+#endif /* EEPROM_CRC_H_ */
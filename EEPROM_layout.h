@@ -0,0 +1,99 @@
+/*
+ * EEPROM_layout.h
+ *
+ *  Typed field accessors generated from a layout table.
+ *
+ *  A layout lists the fields of a parameter area with their type and offset:
+ *
+ *      #define CONFIG_FIELDS(X, P)                 \
+ *          X(P, serial,      uint32_t,  0x00)      \
+ *          X(P, gain,        int16_t,   0x04)      \
+ *          X(P, calibration, Calib_t,   0x20)
+ *
+ *  EEPROM_LAYOUT_DECLARE(config, CONFIG_FIELDS, 0x100) in a header declares
+ *  config_get_serial(), config_set_serial() and the address constants
+ *  config_ADDR_serial etc. for a layout at address 0x100. EEPROM_LAYOUT_DEFINE(config,
+ *  CONFIG_FIELDS, 32, 4096) in one source file defines the accessors and checks the
+ *  layout against the page size and the capacity of the part at compile time.
+ */
+
+#ifndef EEPROM_LAYOUT_H_
+#define EEPROM_LAYOUT_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief Compile time assertion, usable at file scope.
+ */
+#define EEPROM_STATIC_ASSERT(cond, name)	typedef char EEPROM_assert_##name[(cond) ? 1 : -1]
+
+/**
+ * @brief Check that a field touches as few pages as possible.
+ *
+ * A field that fits in a page must not cross a page boundary, a larger field must
+ * start on a page boundary.
+ */
+#define EEPROM_LAYOUT_FIELD_FITS(addr, size, pageSize)	\
+	(((size) > (pageSize)) ? (((addr) % (pageSize)) == 0) : ((((addr) % (pageSize)) + (size)) <= (pageSize)))
+
+#define EEPROM_LAYOUT_ADDR(P, name, type, offset)		P##_ADDR_##name = P##_BASE + (offset),
+
+#define EEPROM_LAYOUT_PROTOTYPES(P, name, type, offset)	\
+	type P##_get_##name(EEPROM_Device* dev);			\
+	EEPROM_Result P##_set_##name(EEPROM_Device* dev, type value);
+
+#define EEPROM_LAYOUT_ACCESSORS(P, name, type, offset)						\
+	EEPROM_STATIC_ASSERT(EEPROM_LAYOUT_FIELD_FITS((uint32_t)P##_ADDR_##name,	\
+		sizeof(type), P##_PAGE_SIZE), P##_##name##_straddles_a_page);			\
+	EEPROM_STATIC_ASSERT((uint32_t)P##_ADDR_##name + sizeof(type) <= P##_CAPACITY,	\
+		P##_##name##_exceeds_the_capacity);										\
+	type P##_get_##name(EEPROM_Device* dev)										\
+	{																			\
+		type value;																\
+		EEPROM_readRange(dev, P##_ADDR_##name, (uint8_t*)&value, sizeof(type));	\
+		return value;															\
+	}																			\
+	EEPROM_Result P##_set_##name(EEPROM_Device* dev, type value)				\
+	{																			\
+		return EEPROM_writeRange(dev, P##_ADDR_##name, (uint8_t*)&value, sizeof(type));	\
+	}
+
+/**
+ * @brief Declare the accessors and the field addresses of a layout.
+ *
+ * For every field this declares the address constant P_ADDR_name and the functions
+ *
+ *     type P_get_name(EEPROM_Device* dev);
+ *     EEPROM_Result P_set_name(EEPROM_Device* dev, type value);
+ *
+ * A getter reads only the bytes of its field, a setter writes only those bytes, with a
+ * single page write for a field that does not cross a page. If the shadow cache is
+ * loaded, both access the field's bytes in the cache. Values are stored in the byte
+ * order of the MCU.
+ *
+ * @param[in] P Prefix of the generated names.
+ * @param[in] FIELDS Layout macro taking (X, P) and expanding X(P, name, type, offset)
+ *            for every field.
+ * @param[in] base Address of the layout in the EEPROM.
+ */
+#define EEPROM_LAYOUT_DECLARE(P, FIELDS, base)					\
+	enum { P##_BASE = (base) };									\
+	enum { FIELDS(EEPROM_LAYOUT_ADDR, P) };						\
+	FIELDS(EEPROM_LAYOUT_PROTOTYPES, P)
+
+/**
+ * @brief Define the accessors of a layout declared with @ref EEPROM_LAYOUT_DECLARE.
+ *
+ * The compilation fails if a field crosses a page boundary it does not have to cross,
+ * see @ref EEPROM_LAYOUT_FIELD_FITS, or if it does not fit in @p capacity.
+ *
+ * @param[in] P Prefix of the generated names.
+ * @param[in] FIELDS Layout macro, as passed to @ref EEPROM_LAYOUT_DECLARE.
+ * @param[in] pageSize Write page size of the part.
+ * @param[in] capacity Size of the memory array of the part.
+ */
+#define EEPROM_LAYOUT_DEFINE(P, FIELDS, pageSize, capacity)		\
+	enum { P##_PAGE_SIZE = (pageSize), P##_CAPACITY = (capacity) };	\
+	FIELDS(EEPROM_LAYOUT_ACCESSORS, P)
+
+#endif /* EEPROM_LAYOUT_H_ */
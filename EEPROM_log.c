@@ -0,0 +1,321 @@
+/**
+ * @file EEPROM_log.c
+ *
+ * @brief Wear leveled circular record log on top of the EEPROM driver.
+ *
+ * @details Every slot starts with a header: the sequence number in big endian
+ * order, the record count and a check byte. Batches are written to the slots in
+ * ring order with increasing sequence numbers, so the newest slot is the one with
+ * the highest sequence number.
+ */
+
+#include "EEPROM_log.h"
+#include <string.h>
+
+#define EEPROM_LOG_COUNT_OFFSET		4
+#define EEPROM_LOG_CHECK_OFFSET		5
+
+static uint8_t EEPROM_logCheck(const uint8_t* header)
+{
+	uint8_t sum = 0;
+	for (uint32_t i = 0; i < EEPROM_LOG_CHECK_OFFSET; i++)
+	{
+		sum += header[i];
+	}
+	// an erased header sums to 0xFB and does not match
+	return (uint8_t)~sum;
+}
+
+static uint32_t EEPROM_logSlotAddr(const EEPROM_Log* log, uint32_t slot)
+{
+	return (log->baseAddr + slot * log->slotSize);
+}
+
+/**
+ * @brief Decode a slot header.
+ *
+ * @return true if the header is valid, @p seq and @p count are set then.
+ */
+static bool EEPROM_logParseHeader(const EEPROM_Log* log, const uint8_t* header, uint32_t* seq, uint16_t* count)
+{
+	if (header[EEPROM_LOG_CHECK_OFFSET] != EEPROM_logCheck(header))
+	{
+		return false;
+	}
+	if ((header[EEPROM_LOG_COUNT_OFFSET] == 0) || (header[EEPROM_LOG_COUNT_OFFSET] > log->recordsPerSlot))
+	{
+		return false;
+	}
+
+	*seq = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | header[3];
+	*count = header[EEPROM_LOG_COUNT_OFFSET];
+	return true;
+}
+
+bool EEPROM_logInit(EEPROM_Log* log, EEPROM_Device* dev, uint32_t baseAddr, uint32_t slotCount,
+					uint16_t slotPages, uint16_t recordSize)
+{
+	uint32_t slotSize = (uint32_t)slotPages * dev->pageSize;
+
+	memset(log, 0, sizeof(*log));
+
+	if ((slotPages == 0) || (slotSize > EEPROM_LOG_MAX_SLOT_SIZE) || (recordSize == 0) ||
+		(recordSize > slotSize - EEPROM_LOG_HEADER_SIZE) || ((baseAddr % dev->pageSize) != 0) ||
+		(baseAddr >= dev->capacity) || (slotCount == 0) || (slotCount > (dev->capacity - baseAddr) / slotSize))
+	{
+		return false;
+	}
+
+	log->dev = dev;
+	log->baseAddr = baseAddr;
+	log->slotCount = slotCount;
+	log->slotSize = slotSize;
+	log->recordSize = recordSize;
+	log->recordsPerSlot = (slotSize - EEPROM_LOG_HEADER_SIZE) / recordSize;
+	if (log->recordsPerSlot > 0xFE)
+	{
+		log->recordsPerSlot = 0xFE;
+	}
+	return true;
+}
+
+/**
+ * @brief Read the headers of several slots.
+ */
+static void EEPROM_logReadHeaders(EEPROM_Log* log, const uint32_t* slots, uint32_t count,
+								  uint8_t (*headers)[EEPROM_LOG_HEADER_SIZE])
+{
+	EEPROM_iovec v[EEPROM_LOG_MOUNT_PROBES];
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		v[i].addr = EEPROM_logSlotAddr(log, slots[i]);
+		v[i].buf = headers[i];
+		v[i].len = EEPROM_LOG_HEADER_SIZE;
+	}
+	EEPROM_readv(log->dev, v, count);
+}
+
+/**
+ * @brief Check whether a slot belongs to the lap that starts at slot 0.
+ *
+ * Slots are written in ring order, so this holds from slot 0 up to the newest slot
+ * and fails for the older lap and for unwritten slots behind it.
+ */
+static bool EEPROM_logInFirstLap(const EEPROM_Log* log, const uint8_t* header, uint32_t slot, uint32_t firstSeq)
+{
+	uint32_t seq;
+	uint16_t count;
+
+	return (EEPROM_logParseHeader(log, header, &seq, &count) && (seq - firstSeq == slot));
+}
+
+void EEPROM_logMount(EEPROM_Log* log)
+{
+	uint8_t headers[EEPROM_LOG_MOUNT_PROBES][EEPROM_LOG_HEADER_SIZE];
+	uint32_t probes[EEPROM_LOG_MOUNT_PROBES];
+	uint32_t last = log->slotCount - 1;
+	uint32_t firstSeq;
+	uint32_t seq;
+	uint16_t count;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t n;
+
+	log->used = 0;
+	log->pending = 0;
+	log->head = 0;
+	log->nextSeq = 0;
+
+	probes[0] = 0;
+	probes[1] = last;
+	EEPROM_logReadHeaders(log, probes, (last > 0) ? 2 : 1, headers);
+
+	if (!EEPROM_logParseHeader(log, headers[0], &firstSeq, &count))
+	{
+		// empty, or the write of slot 0 was torn after the ring wrapped around
+		if ((last > 0) && EEPROM_logParseHeader(log, headers[1], &seq, &count))
+		{
+			log->nextSeq = seq + 1;
+			log->used = log->slotCount;
+		}
+		return;
+	}
+
+	// lo is in the first lap, hi is not, slot count is a sentinel
+	lo = 0;
+	hi = log->slotCount;
+	if ((last > 0) && EEPROM_logInFirstLap(log, headers[1], last, firstSeq))
+	{
+		lo = last;
+	}
+
+	while (hi - lo > 1)
+	{
+		uint32_t span = hi - lo;
+
+		n = 0;
+		for (uint32_t i = 1; i <= EEPROM_LOG_MOUNT_PROBES; i++)
+		{
+			uint32_t probe = lo + (span * i) / (EEPROM_LOG_MOUNT_PROBES + 1);
+			if ((probe > lo) && ((n == 0) || (probe > probes[n - 1])))
+			{
+				probes[n++] = probe;
+			}
+		}
+		EEPROM_logReadHeaders(log, probes, n, headers);
+
+		uint32_t i = 0;
+		while ((i < n) && EEPROM_logInFirstLap(log, headers[i], probes[i], firstSeq))
+		{
+			lo = probes[i];
+			i++;
+		}
+		if (i < n)
+		{
+			hi = probes[i];
+		}
+	}
+
+	log->head = (lo + 1) % log->slotCount;
+	log->nextSeq = firstSeq + lo + 1;
+	log->used = lo + 1;
+
+	// a written slot after the newest one means the ring has wrapped around, the
+	// second one is checked too in case the last write was torn
+	if (log->head != 0)
+	{
+		n = 0;
+		probes[n++] = log->head;
+		if (log->head + 1 < log->slotCount)
+		{
+			probes[n++] = log->head + 1;
+		}
+		EEPROM_logReadHeaders(log, probes, n, headers);
+		for (uint32_t i = 0; i < n; i++)
+		{
+			if (EEPROM_logParseHeader(log, headers[i], &seq, &count))
+			{
+				log->used = log->slotCount;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Write a part of a slot and wait until it is written and verified.
+ */
+static EEPROM_Result EEPROM_logWrite(EEPROM_Log* log, uint32_t addr, uint8_t* data, uint32_t length)
+{
+	EEPROM_Result result = EEPROM_writeRange(log->dev, addr, data, length);
+
+	if (result == Result_Ok)
+	{
+		result = EEPROM_wait(log->dev);
+	}
+	return result;
+}
+
+EEPROM_Result EEPROM_logSync(EEPROM_Log* log)
+{
+	uint8_t* header = log->batch;
+	uint32_t addr = EEPROM_logSlotAddr(log, log->head);
+	uint32_t length = EEPROM_LOG_HEADER_SIZE + log->pending * log->recordSize;
+	uint32_t first = (length < log->dev->pageSize) ? length : log->dev->pageSize;
+	uint8_t check;
+	EEPROM_Result result;
+
+	if (log->pending == 0)
+	{
+		return Result_Ok;
+	}
+
+	header[0] = log->nextSeq >> 24;
+	header[1] = log->nextSeq >> 16;
+	header[2] = log->nextSeq >> 8;
+	header[3] = log->nextSeq;
+	header[EEPROM_LOG_COUNT_OFFSET] = log->pending;
+	check = EEPROM_logCheck(header);
+
+	if (length > first)
+	{
+		// the header of the previous lap stays valid until the first page is
+		// written, so that page goes first with a wrong check byte, then the other
+		// pages, and the check byte last
+		header[EEPROM_LOG_CHECK_OFFSET] = (uint8_t)~check;
+		result = EEPROM_logWrite(log, addr, log->batch, first);
+		header[EEPROM_LOG_CHECK_OFFSET] = check;
+		if (result == Result_Ok)
+		{
+			result = EEPROM_logWrite(log, addr + first, &log->batch[first], length - first);
+		}
+		if (result == Result_Ok)
+		{
+			result = EEPROM_logWrite(log, addr + EEPROM_LOG_CHECK_OFFSET, &header[EEPROM_LOG_CHECK_OFFSET], 1);
+		}
+	}
+	else
+	{
+		header[EEPROM_LOG_CHECK_OFFSET] = check;
+		result = EEPROM_logWrite(log, addr, log->batch, length);
+	}
+	if (result != Result_Ok)
+	{
+		// keep the batch for another attempt on the same slot
+		return result;
+	}
+
+	log->head = (log->head + 1) % log->slotCount;
+	log->nextSeq++;
+	if (log->used < log->slotCount)
+	{
+		log->used++;
+	}
+	log->pending = 0;
+	return Result_Ok;
+}
+
+EEPROM_Result EEPROM_logAppend(EEPROM_Log* log, const void* record)
+{
+	if (log->pending >= log->recordsPerSlot)
+	{
+		EEPROM_Result result = EEPROM_logSync(log);
+		if (result != Result_Ok)
+		{
+			return result;
+		}
+	}
+
+	memcpy(&log->batch[EEPROM_LOG_HEADER_SIZE + log->pending * log->recordSize], record, log->recordSize);
+	log->pending++;
+
+	if (log->pending < log->recordsPerSlot)
+	{
+		return Result_Ok;
+	}
+	return EEPROM_logSync(log);
+}
+
+uint16_t EEPROM_logReadSlot(EEPROM_Log* log, uint32_t back, void* records)
+{
+	uint8_t header[EEPROM_LOG_HEADER_SIZE];
+	uint32_t slot;
+	uint32_t seq;
+	uint16_t count;
+
+	if (back >= log->used)
+	{
+		return 0;
+	}
+
+	slot = (log->head + log->slotCount - 1 - back) % log->slotCount;
+	EEPROM_readRange(log->dev, EEPROM_logSlotAddr(log, slot), header, sizeof(header));
+	if (!EEPROM_logParseHeader(log, header, &seq, &count) || (seq != log->nextSeq - 1 - back))
+	{
+		return 0;
+	}
+
+	EEPROM_readRange(log->dev, EEPROM_logSlotAddr(log, slot) + EEPROM_LOG_HEADER_SIZE, records,
+					 count * log->recordSize);
+	return count;
+}
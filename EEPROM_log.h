@@ -0,0 +1,148 @@
+/*
+ * EEPROM_log.h
+ *
+ *  Wear leveled circular record log on top of the EEPROM driver.
+ */
+
+#ifndef EEPROM_LOG_H_
+#define EEPROM_LOG_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief Size of the header at the start of every slot.
+ *
+ * The header holds the 32 bit sequence number of the slot, the number of records
+ * in the slot and a check byte over the first five header bytes.
+ */
+#define EEPROM_LOG_HEADER_SIZE		6
+
+/**
+ * @brief Slot headers read per round of @ref EEPROM_logMount.
+ *
+ * Each round splits the remaining slots in EEPROM_LOG_MOUNT_PROBES + 1 parts, so a
+ * mount takes about log(slotCount) / log(EEPROM_LOG_MOUNT_PROBES + 1) rounds.
+ */
+#ifndef EEPROM_LOG_MOUNT_PROBES
+#define EEPROM_LOG_MOUNT_PROBES		3
+#endif
+
+#if EEPROM_LOG_MOUNT_PROBES < 2
+#error "EEPROM_LOG_MOUNT_PROBES must be at least 2"
+#endif
+
+/**
+ * @brief Largest slot size in bytes.
+ *
+ * Sizes the batch buffer of every @ref EEPROM_Log, the slot of a log, slotPages
+ * times the page size, must not exceed it.
+ */
+#ifndef EEPROM_LOG_MAX_SLOT_SIZE
+#define EEPROM_LOG_MAX_SLOT_SIZE	(4 * EEPROM_MAX_PAGE_SIZE)
+#endif
+
+/**
+ * @brief State of a record log.
+ *
+ * The log occupies a ring of page aligned slots of one or more pages each. Appended
+ * records are collected in @p batch and written to the next slot once it is full,
+ * so the header is written once per slot instead of once per page and consecutive
+ * batches move on through the whole ring.
+ */
+typedef struct
+{
+	EEPROM_Device* dev;			/**< Device holding the log								*/
+	uint32_t baseAddr;			/**< Address of the first slot							*/
+	uint32_t slotCount;			/**< Number of slots in the ring						*/
+	uint16_t slotSize;			/**< Size of a slot, a multiple of the page size		*/
+	uint16_t recordSize;		/**< Size of a record									*/
+	uint16_t recordsPerSlot;	/**< Records that fit in one slot						*/
+	uint32_t head;				/**< Slot of the next batch								*/
+	uint32_t nextSeq;			/**< Sequence number of the next batch					*/
+	uint32_t used;				/**< Written slots, at most slotCount					*/
+	uint16_t pending;			/**< Records in the batch								*/
+	uint8_t batch[EEPROM_LOG_MAX_SLOT_SIZE];	/**< Header and records of the next slot	*/
+}EEPROM_Log;
+
+/**
+ * @brief Initialize a record log.
+ *
+ * The log is empty until @ref EEPROM_logMount finds the slots written before.
+ *
+ * @param[out] log Pointer to the log.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] baseAddr Address of the first slot, must be page aligned.
+ * @param[in] slotCount Number of slots.
+ * @param[in] slotPages Pages per slot, a slot must not exceed
+ *            @ref EEPROM_LOG_MAX_SLOT_SIZE. Larger slots spread the header over
+ *            more records, use them for records that are large compared to a page.
+ * @param[in] recordSize Size of a record, at most the slot size minus
+ *            @ref EEPROM_LOG_HEADER_SIZE.
+ *
+ * @return true if the log fits the device.
+ */
+bool EEPROM_logInit(EEPROM_Log* log, EEPROM_Device* dev, uint32_t baseAddr, uint32_t slotCount,
+					uint16_t slotPages, uint16_t recordSize);
+
+/**
+ * @brief Find the newest slot of the log.
+ *
+ * Slots are written in ring order with consecutive sequence numbers, so from slot 0
+ * up to the newest slot the sequence number grows by one per slot, and the slot
+ * after the newest one is unwritten or belongs to the previous lap. This function
+ * searches for that boundary and reads only the headers of a few slots per round,
+ * instead of the whole log. Slots with an invalid header, such as erased or torn
+ * ones, are treated as unwritten.
+ *
+ * @param[in,out] log Pointer to the log.
+ *
+ * @return None.
+ */
+void EEPROM_logMount(EEPROM_Log* log);
+
+/**
+ * @brief Append a record.
+ *
+ * The record is added to the batch. A full batch is written to the next slot,
+ * overwriting the oldest one once the ring is full. If the batch is still full
+ * because an earlier write of it failed, it is written again first and the record
+ * is not added unless that succeeds.
+ *
+ * @param[in,out] log Pointer to the log.
+ * @param[in] record Pointer to recordSize bytes.
+ *
+ * @return Result_Ok, or the error of the slot write. The record is added in any
+ *         case once the batch had room for it.
+ */
+EEPROM_Result EEPROM_logAppend(EEPROM_Log* log, const void* record);
+
+/**
+ * @brief Write a partially filled batch.
+ *
+ * The remaining space of the slot is not used, the next record starts a new
+ * slot. Call it before power down to keep the records of the current batch.
+ * A slot of several pages is first made invalid by writing its first page with
+ * a wrong check byte, then the other pages are written and the check byte last.
+ * A torn write thus leaves the slot invalid, at the cost of one more page cycle.
+ * The header check does not cover the records, so a write cycle torn within the
+ * page of a single page slot can still leave a valid header on mixed records.
+ *
+ * @param[in,out] log Pointer to the log.
+ *
+ * @return Result_Ok, or the error of the slot write. On an error the batch and
+ *         the head slot are kept, so the call can be repeated.
+ */
+EEPROM_Result EEPROM_logSync(EEPROM_Log* log);
+
+/**
+ * @brief Read the records of a written slot.
+ *
+ * @param[in] log Pointer to the log.
+ * @param[in] back Age of the slot, 0 is the newest written slot.
+ * @param[out] records Buffer of recordsPerSlot records.
+ *
+ * @return Number of records read, 0 if the slot is not written or invalid.
+ */
+uint16_t EEPROM_logReadSlot(EEPROM_Log* log, uint32_t back, void* records);
+
+#endif /* EEPROM_LOG_H_ */
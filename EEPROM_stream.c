@@ -0,0 +1,77 @@
+/**
+ * @file EEPROM_stream.c
+ *
+ * @brief Sequential reader with a read-ahead buffer on top of the EEPROM driver.
+ *
+ * @details The buffer always holds a contiguous range ending at or before the end of
+ * the stream, so a refill never reads past the range the reader was opened for.
+ */
+
+#include "EEPROM_stream.h"
+#include <string.h>
+
+bool EEPROM_streamOpen(EEPROM_Stream* stream, EEPROM_Device* dev, uint32_t addr, uint32_t length,
+					   uint8_t* buffer, uint32_t bufferSize)
+{
+	stream->dev = dev;
+	stream->buffer = buffer;
+	stream->bufferSize = bufferSize;
+	stream->bufferAddr = addr;
+	stream->buffered = 0;
+	stream->pos = addr;
+	stream->end = addr + length;
+
+	return ((bufferSize > 0) && (addr <= dev->capacity) && (length <= dev->capacity - addr));
+}
+
+uint32_t EEPROM_streamRead(EEPROM_Stream* stream, uint8_t* data, uint32_t length)
+{
+	uint32_t done = 0;
+
+	if (length > stream->end - stream->pos)
+	{
+		length = stream->end - stream->pos;
+	}
+
+	while (done < length)
+	{
+		uint32_t offset = stream->pos - stream->bufferAddr;
+		uint32_t chunk = length - done;
+
+		if ((stream->pos >= stream->bufferAddr) && (offset < stream->buffered))
+		{
+			if (chunk > stream->buffered - offset)
+			{
+				chunk = stream->buffered - offset;
+			}
+			memcpy(&data[done], &stream->buffer[offset], chunk);
+		}
+		else if (chunk >= stream->bufferSize)
+		{
+			// nothing to gain from the buffer
+			EEPROM_readRange(stream->dev, stream->pos, &data[done], chunk);
+		}
+		else
+		{
+			uint32_t fill = stream->end - stream->pos;
+			if (fill > stream->bufferSize)
+			{
+				fill = stream->bufferSize;
+			}
+			EEPROM_readRange(stream->dev, stream->pos, stream->buffer, fill);
+			stream->bufferAddr = stream->pos;
+			stream->buffered = fill;
+			continue;
+		}
+
+		stream->pos += chunk;
+		done += chunk;
+	}
+	return done;
+}
+
+void EEPROM_streamClose(EEPROM_Stream* stream)
+{
+	stream->buffered = 0;
+	stream->pos = stream->end;
+}
@@ -0,0 +1,74 @@
+/*
+ * EEPROM_stream.h
+ *
+ *  Sequential reader with a read-ahead buffer on top of the EEPROM driver.
+ */
+
+#ifndef EEPROM_STREAM_H_
+#define EEPROM_STREAM_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief State of a sequential reader.
+ *
+ * Every read that is not served from the buffer refills it with one READ transaction,
+ * so a sequence of small reads costs the opcode and the address bytes once per buffer
+ * instead of once per read. The buffer is not updated by writes, a range written
+ * while the reader is open may be read with its old content until the buffer is
+ * refilled.
+ */
+typedef struct
+{
+	EEPROM_Device* dev;		/**< Device being read							*/
+	uint8_t* buffer;		/**< Read-ahead buffer of the caller			*/
+	uint32_t bufferSize;	/**< Size of the buffer							*/
+	uint32_t bufferAddr;	/**< Address of the first buffered byte			*/
+	uint32_t buffered;		/**< Number of valid bytes in the buffer		*/
+	uint32_t pos;			/**< Address of the next byte to read			*/
+	uint32_t end;			/**< End address of the stream					*/
+}EEPROM_Stream;
+
+/**
+ * @brief Open a sequential reader over a range.
+ *
+ * A buffer of a few pages amortizes the command overhead over many small reads.
+ *
+ * @param[out] stream Pointer to the reader.
+ * @param[in] dev Pointer to the EEPROM_Device structure.
+ * @param[in] addr Start address of the range.
+ * @param[in] length Length of the range.
+ * @param[in] buffer Read-ahead buffer, must stay valid until the reader is closed.
+ * @param[in] bufferSize Size of the buffer.
+ *
+ * @return true if the range fits the device and the buffer is not empty.
+ */
+bool EEPROM_streamOpen(EEPROM_Stream* stream, EEPROM_Device* dev, uint32_t addr, uint32_t length,
+					   uint8_t* buffer, uint32_t bufferSize);
+
+/**
+ * @brief Read the next bytes of the stream.
+ *
+ * Bytes are taken from the buffer while it holds them. A read of at least the buffer
+ * size bypasses the buffer and is transferred directly.
+ *
+ * @param[in,out] stream Pointer to the reader.
+ * @param[out] data Buffer for the data.
+ * @param[in] length Number of bytes to read.
+ *
+ * @return The number of bytes read, less than @p length at the end of the stream.
+ */
+uint32_t EEPROM_streamRead(EEPROM_Stream* stream, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Close a sequential reader.
+ *
+ * The buffer is released, further reads return 0.
+ *
+ * @param[in,out] stream Pointer to the reader.
+ *
+ * @return None.
+ */
+void EEPROM_streamClose(EEPROM_Stream* stream);
+
+#endif /* EEPROM_STREAM_H_ */
@@ -0,0 +1,155 @@
+/**
+ * @file EEPROM_stripe.c
+ *
+ * @brief Volume striped over several EEPROM devices.
+ *
+ * @details The stripe unit is one page, so every part of a write sent to a device is
+ * a single page write and the devices never wait for each other.
+ */
+
+#include "EEPROM_stripe.h"
+
+/**
+ * @brief Device address of a volume address.
+ */
+static uint32_t EEPROM_stripeDevAddr(const EEPROM_Stripe* vol, uint32_t addr)
+{
+	uint32_t unit = addr / vol->unitSize;
+	return ((unit / vol->count) * vol->unitSize + addr % vol->unitSize);
+}
+
+/**
+ * @brief Number of bytes from @p addr to the end of its stripe unit, at most @p end.
+ */
+static uint32_t EEPROM_stripeChunk(const EEPROM_Stripe* vol, uint32_t addr, uint32_t end)
+{
+	uint32_t chunk = vol->unitSize - (addr % vol->unitSize);
+	return (chunk < end - addr) ? chunk : end - addr;
+}
+
+bool EEPROM_stripeInit(EEPROM_Stripe* vol, EEPROM_Device* const* devs, uint8_t count)
+{
+	uint32_t capacity;
+
+	if ((count == 0) || (count > EEPROM_STRIPE_MAX_DEVICES))
+	{
+		return false;
+	}
+
+	capacity = devs[0]->capacity;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (devs[i]->pageSize != devs[0]->pageSize)
+		{
+			return false;
+		}
+		if (devs[i]->capacity < capacity)
+		{
+			capacity = devs[i]->capacity;
+		}
+		vol->devs[i] = devs[i];
+	}
+
+	vol->count = count;
+	vol->unitSize = devs[0]->pageSize;
+	vol->capacity = (capacity - capacity % vol->unitSize) * count;
+	return true;
+}
+
+void EEPROM_stripeRead(EEPROM_Stripe* vol, uint32_t addr, uint8_t* data, uint32_t length)
+{
+	uint32_t end = addr + length;
+
+	while (addr < end)
+	{
+		uint32_t chunk = EEPROM_stripeChunk(vol, addr, end);
+		EEPROM_Device* dev = vol->devs[(addr / vol->unitSize) % vol->count];
+
+		EEPROM_readRange(dev, EEPROM_stripeDevAddr(vol, addr), data, chunk);
+		addr += chunk;
+		data += chunk;
+	}
+}
+
+EEPROM_Result EEPROM_stripeWrite(EEPROM_Stripe* vol, uint32_t addr, uint8_t* data, uint32_t length)
+{
+	const EEPROM_WaitPolicy* policy = &vol->devs[0]->waitPolicy;
+	uint32_t cursor[EEPROM_STRIPE_MAX_DEVICES];
+	uint32_t firstUnit = addr / vol->unitSize;
+	uint32_t end = addr + length;
+	uint32_t idle = 0;
+
+	// the next volume address written to each device
+	for (uint32_t i = 0; i < vol->count; i++)
+	{
+		uint32_t unit = firstUnit + (i + vol->count - firstUnit % vol->count) % vol->count;
+		cursor[unit % vol->count] = (unit == firstUnit) ? addr : unit * vol->unitSize;
+	}
+
+	while (1)
+	{
+		bool remaining = false;
+		bool started = false;
+
+		for (uint32_t i = 0; i < vol->count; i++)
+		{
+			EEPROM_Device* dev = vol->devs[i];
+			uint32_t chunk;
+			EEPROM_Result result;
+
+			if (cursor[i] >= end)
+			{
+				continue;
+			}
+			remaining = true;
+
+			// a device in its write cycle is skipped, the others go on meanwhile
+			if ((EEPROM_readStatusReg(dev) & EEPROM_STATUS_BIT_RDY) != 0)
+			{
+				continue;
+			}
+
+			chunk = EEPROM_stripeChunk(vol, cursor[i], end);
+			result = EEPROM_writeRange(dev, EEPROM_stripeDevAddr(vol, cursor[i]), &data[cursor[i] - addr], chunk);
+			if (result != Result_Ok)
+			{
+				return result;
+			}
+
+			cursor[i] = (cursor[i] / vol->unitSize + vol->count) * vol->unitSize;
+			started = true;
+		}
+
+		if (!remaining)
+		{
+			return Result_Ok;
+		}
+		if (started)
+		{
+			idle = 0;
+			continue;
+		}
+
+		if ((policy->timeoutUs != 0) && (idle >= policy->timeoutUs))
+		{
+			return Result_Timeout;
+		}
+		vol->devs[0]->hal->delayUs(vol->devs[0], policy->minPollUs);
+		idle += policy->minPollUs;
+	}
+}
+
+EEPROM_Result EEPROM_stripeWait(EEPROM_Stripe* vol)
+{
+	EEPROM_Result result = Result_Ok;
+
+	for (uint32_t i = 0; i < vol->count; i++)
+	{
+		EEPROM_Result devResult = EEPROM_wait(vol->devs[i]);
+		if (result == Result_Ok)
+		{
+			result = devResult;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,89 @@
+/*
+ * EEPROM_stripe.h
+ *
+ *  Volume striped over several EEPROM devices.
+ */
+
+#ifndef EEPROM_STRIPE_H_
+#define EEPROM_STRIPE_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief Largest number of devices of a striped volume.
+ */
+#ifndef EEPROM_STRIPE_MAX_DEVICES
+#define EEPROM_STRIPE_MAX_DEVICES	4
+#endif
+
+/**
+ * @brief Volume striped over several devices.
+ *
+ * Consecutive pages of the volume go to consecutive devices, so page n is page
+ * n / count of device n % count. A write runs on all devices at once: while one
+ * device is in its write cycle the next page is sent to the next device, so the write
+ * cycles overlap and the write throughput grows with the number of devices. The
+ * devices may be on the same or on different SPI buses.
+ */
+typedef struct
+{
+	EEPROM_Device* devs[EEPROM_STRIPE_MAX_DEVICES];	/**< Devices in stripe order	*/
+	uint8_t count;									/**< Number of devices			*/
+	uint16_t unitSize;								/**< Stripe unit, the page size	*/
+	uint32_t capacity;								/**< Size of the volume			*/
+}EEPROM_Stripe;
+
+/**
+ * @brief Initialize a striped volume.
+ *
+ * All devices must have the same page size. The volume takes the size of the smallest
+ * device from each of them.
+ *
+ * @param[out] vol Pointer to the volume.
+ * @param[in] devs Array of initialized devices.
+ * @param[in] count Number of devices, at most EEPROM_STRIPE_MAX_DEVICES.
+ *
+ * @return true if the devices can be striped.
+ */
+bool EEPROM_stripeInit(EEPROM_Stripe* vol, EEPROM_Device* const* devs, uint8_t count);
+
+/**
+ * @brief Read a range of the volume.
+ *
+ * @param[in] vol Pointer to the volume.
+ * @param[in] addr Address in the volume.
+ * @param[out] data Buffer for the data.
+ * @param[in] length Number of bytes to read.
+ *
+ * @return None.
+ */
+void EEPROM_stripeRead(EEPROM_Stripe* vol, uint32_t addr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Write a range of the volume.
+ *
+ * The devices are polled round robin. Each device that is ready gets its next page, so
+ * no device waits for another one. The function returns once the last page has been
+ * started, call @ref EEPROM_stripeWait before the data must be committed. The timeout
+ * of the wait policy of the first device limits the time without progress.
+ *
+ * @param[in] vol Pointer to the volume.
+ * @param[in] addr Address in the volume.
+ * @param[in] data Pointer to the data.
+ * @param[in] length Number of bytes to write.
+ *
+ * @return Result_Ok, Result_Timeout if no device became ready in time, or the first
+ *         error returned by @ref EEPROM_writeRange.
+ */
+EEPROM_Result EEPROM_stripeWrite(EEPROM_Stripe* vol, uint32_t addr, uint8_t* data, uint32_t length);
+
+/**
+ * @brief Wait until the writes of all devices of the volume are committed.
+ *
+ * @param[in] vol Pointer to the volume.
+ *
+ * @return Result_Ok, or the first error returned by @ref EEPROM_wait.
+ */
+EEPROM_Result EEPROM_stripeWait(EEPROM_Stripe* vol);
+
+#endif /* EEPROM_STRIPE_H_ */
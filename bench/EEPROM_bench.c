@@ -0,0 +1,167 @@
+/**
+ * @file EEPROM_bench.c
+ *
+ * @brief Throughput and latency benchmark of the EEPROM driver.
+ *
+ * @details Each case repeats one driver function, measures the elapsed time with the
+ * configured time source and samples the optional bus counters before and after.
+ */
+
+#include "EEPROM_bench.h"
+
+typedef enum
+{
+	Case_ReadByte,
+	Case_WriteByte,
+	Case_ReadRange,
+	Case_WriteRange,
+	Case_Wait,
+}EEPROM_BenchCase;
+
+static const uint32_t EEPROM_benchSizes[] = {1, 4, 16, 32, 64, 256, 1024, 4096};
+
+static void EEPROM_benchCounters(const EEPROM_BenchConfig* config, EEPROM_BenchCounters* counters)
+{
+	counters->busBytes = 0;
+	counters->transactions = 0;
+	counters->statusPolls = 0;
+	if (config->getCounters != NULL)
+	{
+		config->getCounters(counters);
+	}
+#if EEPROM_USE_STATISTICS == TRUE
+	else
+	{
+		// the counters of the driver, also available on the target
+		EEPROM_Statistics stats;
+		EEPROM_getStatistics(config->dev, &stats);
+		counters->busBytes = stats.spiBytes;
+		counters->transactions = stats.transactions;
+		counters->statusPolls = stats.waitPolls;
+	}
+#endif
+}
+
+static void EEPROM_benchCase(const EEPROM_BenchConfig* config, EEPROM_BenchCase benchCase,
+							 const char* name, uint32_t size, uint32_t offset)
+{
+	EEPROM_Device* dev = config->dev;
+	uint32_t addr = config->baseAddr + offset;
+	EEPROM_BenchCounters before;
+	EEPROM_BenchCounters after;
+	EEPROM_BenchResult result;
+	uint32_t elapsed = 0;
+
+	for (uint32_t i = 0; i < size; i++)
+	{
+		config->buffer[i] = (uint8_t)(i + offset);
+	}
+
+	EEPROM_wait(dev);
+	EEPROM_benchCounters(config, &before);
+	uint32_t start = config->getTimeUs();
+
+	for (uint32_t i = 0; i < config->iterations; i++)
+	{
+		switch (benchCase)
+		{
+		case Case_ReadByte:
+			config->buffer[0] = EEPROM_readByte(dev, addr);
+			break;
+
+		case Case_WriteByte:
+			EEPROM_writeByte(dev, addr, config->buffer[0]);
+			EEPROM_wait(dev);
+			break;
+
+		case Case_ReadRange:
+			EEPROM_readRange(dev, addr, config->buffer, size);
+			break;
+
+		case Case_WriteRange:
+			EEPROM_writeRange(dev, addr, config->buffer, size);
+			EEPROM_wait(dev);
+			break;
+
+		case Case_Wait:
+		{
+			// only the wait is timed, the write that starts the cycle is not
+			uint32_t pause = config->getTimeUs();
+			EEPROM_writeByte(dev, addr, config->buffer[0]);
+			start += config->getTimeUs() - pause;
+			EEPROM_wait(dev);
+			break;
+		}
+		}
+	}
+
+	elapsed = config->getTimeUs() - start;
+	EEPROM_benchCounters(config, &after);
+
+	result.name = name;
+	result.size = size;
+	result.offset = offset;
+	result.ops = config->iterations;
+	result.totalUs = elapsed;
+	result.usPerOp = elapsed / config->iterations;
+	result.nsPerOp = (uint32_t)(((uint64_t)elapsed * 1000) / config->iterations);
+	result.bytesPerSecond = UINT32_MAX;
+	if (elapsed != 0)
+	{
+		uint64_t rate = ((uint64_t)size * config->iterations * 1000000) / elapsed;
+		if (rate < UINT32_MAX)
+		{
+			result.bytesPerSecond = (uint32_t)rate;
+		}
+	}
+	result.statusPolls = (after.statusPolls - before.statusPolls) / config->iterations;
+	result.busBytes = (after.busBytes - before.busBytes) / config->iterations;
+	result.busOccupancy = 0;
+	if ((config->sckHz != 0) && (elapsed != 0))
+	{
+		uint64_t busUs = ((uint64_t)(after.busBytes - before.busBytes) * 8 * 1000000) / config->sckHz;
+		result.busOccupancy = (uint32_t)((busUs * 100) / elapsed);
+	}
+
+	if (config->report != NULL)
+	{
+		config->report(&result, config->reportCtx);
+	}
+}
+
+static void EEPROM_benchRanges(const EEPROM_BenchConfig* config, EEPROM_BenchCase benchCase, const char* name)
+{
+	uint32_t pageSize = config->dev->pageSize;
+	const uint32_t offsets[] = {0, 1, pageSize - 1};
+
+	for (uint32_t s = 0; s < sizeof(EEPROM_benchSizes) / sizeof(EEPROM_benchSizes[0]); s++)
+	{
+		uint32_t size = EEPROM_benchSizes[s];
+		if (size > config->bufferSize)
+		{
+			continue;
+		}
+
+		for (uint32_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)
+		{
+			if (offsets[o] + size <= config->areaSize)
+			{
+				EEPROM_benchCase(config, benchCase, name, size, offsets[o]);
+			}
+		}
+	}
+}
+
+void EEPROM_benchRun(const EEPROM_BenchConfig* config)
+{
+	if ((config->iterations == 0) || (config->bufferSize == 0) || (config->areaSize == 0))
+	{
+		return;
+	}
+
+	EEPROM_benchCase(config, Case_ReadByte, "EEPROM_readByte", 1, 0);
+	EEPROM_benchCase(config, Case_WriteByte, "EEPROM_writeByte", 1, 0);
+	EEPROM_benchRanges(config, Case_ReadRange, "EEPROM_readRange");
+	EEPROM_benchRanges(config, Case_WriteRange, "EEPROM_writeRange");
+	EEPROM_benchCase(config, Case_Wait, "EEPROM_wait", 1, 0);
+}
@@ -0,0 +1,77 @@
+/*
+ * EEPROM_bench.h
+ *
+ *  Throughput and latency benchmark of the EEPROM driver.
+ */
+
+#ifndef EEPROM_BENCH_H_
+#define EEPROM_BENCH_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief Bus activity counters sampled around each benchmark case.
+ */
+typedef struct
+{
+	uint32_t busBytes;			/**< Bytes exchanged on the SPI bus				*/
+	uint32_t transactions;		/**< Chip select framed transactions			*/
+	uint32_t statusPolls;		/**< Status register reads						*/
+}EEPROM_BenchCounters;
+
+/**
+ * @brief Result of one benchmark case.
+ */
+typedef struct
+{
+	const char* name;			/**< Function under test						*/
+	uint32_t size;				/**< Bytes per operation						*/
+	uint32_t offset;			/**< Offset of the start address within a page	*/
+	uint32_t ops;				/**< Number of operations timed					*/
+	uint32_t totalUs;			/**< Time of all operations						*/
+	uint32_t usPerOp;			/**< Average time per operation					*/
+	uint32_t nsPerOp;			/**< Average time per operation in nanoseconds	*/
+	uint32_t bytesPerSecond;	/**< Payload throughput, saturates at UINT32_MAX	*/
+	uint32_t statusPolls;		/**< Status register reads per operation		*/
+	uint32_t busBytes;			/**< Bus bytes per operation					*/
+	uint32_t busOccupancy;		/**< Share of the time the bus was clocking,
+									 in percent, 0 if sckHz is not set			*/
+}EEPROM_BenchResult;
+
+/**
+ * @brief Configuration of a benchmark run.
+ */
+typedef struct
+{
+	EEPROM_Device* dev;			/**< Device under test							*/
+	uint32_t (*getTimeUs)(void);	/**< Free running microsecond time source,
+									 e.g. the SPC5 STM counter					*/
+	void (*getCounters)(EEPROM_BenchCounters* counters);	/**< Bus counters, may be NULL,
+									 the driver statistics are used then if enabled	*/
+	void (*report)(const EEPROM_BenchResult* result, void* ctx);	/**< Called per case	*/
+	void* reportCtx;			/**< User pointer passed to report				*/
+	uint32_t baseAddr;			/**< Start of the area the benchmark may overwrite	*/
+	uint32_t areaSize;			/**< Size of that area							*/
+	uint8_t* buffer;			/**< Scratch buffer								*/
+	uint32_t bufferSize;		/**< Size of the scratch buffer					*/
+	uint32_t iterations;		/**< Operations per case						*/
+	uint32_t sckHz;				/**< SPI clock for the bus occupancy, may be 0	*/
+}EEPROM_BenchConfig;
+
+/**
+ * @brief Run all benchmark cases.
+ *
+ * Times single byte reads and writes, range reads and writes over several sizes and
+ * start offsets within a page, and the latency of @ref EEPROM_wait after a byte
+ * write. Writes are followed by @ref EEPROM_wait, so they include the write cycle.
+ * The content of the configured area is overwritten. Cases that do not fit into the
+ * area or the scratch buffer are skipped. The cases always run in the same order,
+ * so reports of different builds can be compared line by line.
+ *
+ * @param[in] config Pointer to the benchmark configuration.
+ *
+ * @return None.
+ */
+void EEPROM_benchRun(const EEPROM_BenchConfig* config);
+
+#endif /* EEPROM_BENCH_H_ */
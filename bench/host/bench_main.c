@@ -0,0 +1,61 @@
+/**
+ * @file bench_main.c
+ *
+ * @brief Host runner of the EEPROM benchmark against the simulated EEPROM.
+ *
+ * @details Prints one CSV line per benchmark case. Time is the simulated time of the
+ * device, so the results include the bus transfers and the write cycles.
+ */
+
+#include "EEPROM_bench.h"
+#include "EEPROM_sim.h"
+#include <stdio.h>
+
+static EEPROM_Sim sim;
+
+static uint32_t simTimeUs(void)
+{
+	return (uint32_t)EEPROM_simTimeUs(&sim);
+}
+
+static void simCounters(EEPROM_BenchCounters* counters)
+{
+	counters->busBytes = sim.counters.busBytes;
+	counters->transactions = sim.counters.transactions;
+	counters->statusPolls = sim.counters.statusPolls;
+}
+
+static void printResult(const EEPROM_BenchResult* result, void* ctx)
+{
+	(void)ctx;
+	printf("%s,%u,%u,%u,%u,%u,%u,%u,%u\n", result->name, result->size, result->offset, result->ops,
+		   result->usPerOp, result->bytesPerSecond, result->statusPolls, result->busBytes, result->busOccupancy);
+}
+
+int main(void)
+{
+	static EEPROM_Device dev;
+	static uint8_t buffer[4096];
+
+	EEPROM_simInit(&sim, &dev, Part_AT25320A);
+
+	EEPROM_BenchConfig config =
+	{
+		.dev = &dev,
+		.getTimeUs = simTimeUs,
+		.getCounters = simCounters,
+		.report = printResult,
+		.reportCtx = NULL,
+		.baseAddr = 0,
+		.areaSize = dev.capacity,
+		.buffer = buffer,
+		.bufferSize = sizeof(buffer),
+		.iterations = 100,
+		.sckHz = sim.sckHz,
+	};
+
+	printf("function,size,offset,ops,us_per_op,bytes_per_s,status_polls,bus_bytes,bus_occupancy\n");
+	EEPROM_benchRun(&config);
+	printf("write_cycles,%u\n", sim.counters.writeCycles);
+	return 0;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file EEPROM_sim.c
+ *
+ * @brief Host-side simulated 25xxx EEPROM with a timing model.
+ *
+ * @details The simulated device decodes the same instructions as the real parts:
+ * the status register with RDY, WEN and the BP bits, the write enable latch, page
+ * latched writes that wrap around within the page, block protection and a write
+ * cycle of configurable length. While a write cycle is in progress only the status
+ * register can be read, every other instruction is ignored.
+ */
+
+#include "EEPROM_sim.h"
+#include <string.h>
+
+#if EEPROM_USE_SPC5_HAL == TRUE
+#error "the simulated EEPROM requires EEPROM_USE_SPC5_HAL set to FALSE"
+#endif
+
+#define SIM_ENABLE_WRITE		0x06
+#define SIM_DISABLE_WRITE		0x04
+#define SIM_READ_STATUS_REG		0x05
+#define SIM_WRITE_STATUS_REG	0x01
+#define SIM_READ_DATA			0x03
+#define SIM_WRITE_DATA			0x02
+#define SIM_OPCODE_A8			0x08	///< A8 of the M95040 within READ and WRITE
+
+#define SIM_STATUS_WRITABLE		(EEPROM_STATUS_BIT_BP | EEPROM_STATUS_BIT_WPEN)
+#define SIM_IDLE_FRAME			0xFF	///< MISO while the device does not drive it
+
+bool EEPROM_simBusy(const EEPROM_Sim* sim)
+{
+	return (sim->timeNs < sim->busyUntilNs);
+}
+
+uint64_t EEPROM_simTimeUs(const EEPROM_Sim* sim)
+{
+	return (sim->timeNs / 1000);
+}
+
+static uint8_t EEPROM_simStatus(const EEPROM_Sim* sim)
+{
+	uint8_t status = sim->status;
+	if (EEPROM_simBusy(sim))
+	{
+		status |= EEPROM_STATUS_BIT_RDY;
+	}
+	if (sim->writeEnabled)
+	{
+		status |= EEPROM_STATUS_BIT_WEN;
+	}
+	return status;
+}
+
+static bool EEPROM_simProtected(const EEPROM_Sim* sim, uint32_t addr)
+{
+	uint32_t protectedSize;
+
+	switch ((sim->status & EEPROM_STATUS_BIT_BP) >> 2)
+	{
+	case BlockProtection_Quarter:
+		protectedSize = sim->capacity / 4;
+		break;
+	case BlockProtection_Half:
+		protectedSize = sim->capacity / 2;
+		break;
+	case BlockProtection_WholeMemory:
+		protectedSize = sim->capacity;
+		break;
+	default:
+		protectedSize = 0;
+		break;
+	}
+	return (addr >= sim->capacity - protectedSize) && (protectedSize != 0);
+}
+
+static void EEPROM_simStartCycle(EEPROM_Sim* sim)
+{
+	sim->writeEnabled = false;
+	sim->busyUntilNs = sim->timeNs + (uint64_t)sim->twcUs * 1000;
+	sim->counters.writeCycles++;
+}
+
+static void EEPROM_simCommitPage(EEPROM_Sim* sim)
+{
+	uint32_t pageBase = sim->addr - (sim->addr % sim->pageSize);
+
+	if (!sim->writeEnabled || EEPROM_simProtected(sim, pageBase))
+	{
+		// the instruction is dropped, the latch is reset nonetheless
+		sim->writeEnabled = false;
+		sim->counters.rejectedWrites++;
+		return;
+	}
+
+	for (uint32_t i = 0; i < sim->pageSize; i++)
+	{
+		if (sim->latched[i])
+		{
+			sim->memory[pageBase + i] = sim->latch[i];
+		}
+	}
+	EEPROM_simStartCycle(sim);
+}
+
+//---------------------------------------HAL Functions---------------------------------------
+static void EEPROM_simSelect(EEPROM_Device* dev)
+{
+	EEPROM_Sim* sim = dev->halCtx;
+
+	sim->selected = true;
+	sim->ignored = false;
+	sim->frame = 0;
+	sim->addr = 0;
+	sim->latchCount = 0;
+	memset(sim->latched, 0, sizeof(sim->latched));
+	sim->timeNs += sim->csNs;
+	sim->counters.transactions++;
+}
+
+static void EEPROM_simDeselect(EEPROM_Device* dev)
+{
+	EEPROM_Sim* sim = dev->halCtx;
+
+	if (!sim->selected)
+	{
+		return;
+	}
+	sim->selected = false;
+
+	if (sim->ignored || (sim->frame == 0))
+	{
+		return;
+	}
+
+	switch (sim->opcode)
+	{
+	case SIM_ENABLE_WRITE:
+		sim->writeEnabled = true;
+		break;
+
+	case SIM_DISABLE_WRITE:
+		sim->writeEnabled = false;
+		break;
+
+	case SIM_WRITE_STATUS_REG:
+		if (sim->frame < 2)
+		{
+			break;
+		}
+		if (!sim->writeEnabled)
+		{
+			sim->counters.rejectedWrites++;
+			break;
+		}
+		sim->status = (sim->status & ~SIM_STATUS_WRITABLE) | (sim->statusData & SIM_STATUS_WRITABLE);
+		EEPROM_simStartCycle(sim);
+		break;
+
+	case SIM_WRITE_DATA:
+		if (sim->latchCount > 0)
+		{
+			EEPROM_simCommitPage(sim);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static uint8_t EEPROM_simExchange(EEPROM_Device* dev, uint8_t frame)
+{
+	EEPROM_Sim* sim = dev->halCtx;
+	uint32_t index = sim->frame++;
+	uint8_t retVal = SIM_IDLE_FRAME;
+
+	sim->timeNs += 8000000000ULL / sim->sckHz;
+	if (!sim->selected)
+	{
+		return retVal;
+	}
+	sim->counters.busBytes++;
+
+	if (index == 0)
+	{
+		sim->opcode = frame;
+		if ((sim->addressFormat == AddressFormat_OneByteA8) &&
+			(((frame & ~SIM_OPCODE_A8) == SIM_READ_DATA) || ((frame & ~SIM_OPCODE_A8) == SIM_WRITE_DATA)))
+		{
+			sim->opcode = frame & ~SIM_OPCODE_A8;
+			sim->addr = ((frame & SIM_OPCODE_A8) != 0) ? 0x100 : 0;
+		}
+
+		if (sim->opcode == SIM_READ_STATUS_REG)
+		{
+			sim->counters.statusPolls++;
+		}
+		else if (EEPROM_simBusy(sim))
+		{
+			sim->ignored = true;
+		}
+		return retVal;
+	}
+
+	if (sim->ignored)
+	{
+		return retVal;
+	}
+
+	switch (sim->opcode)
+	{
+	case SIM_READ_STATUS_REG:
+		// shifted out repeatedly as long as the chip select stays low
+		retVal = EEPROM_simStatus(sim);
+		break;
+
+	case SIM_WRITE_STATUS_REG:
+		if (index == 1)
+		{
+			sim->statusData = frame;
+		}
+		break;
+
+	case SIM_READ_DATA:
+	case SIM_WRITE_DATA:
+		if (index <= sim->addressBytes)
+		{
+			if (sim->addressFormat == AddressFormat_OneByteA8)
+			{
+				sim->addr |= frame;
+			}
+			else
+			{
+				sim->addr = (sim->addr << 8) | frame;
+			}
+			if (index == sim->addressBytes)
+			{
+				sim->addr %= sim->capacity;
+			}
+		}
+		else if (sim->opcode == SIM_READ_DATA)
+		{
+			retVal = sim->memory[sim->addr];
+			sim->addr = (sim->addr + 1) % sim->capacity;
+		}
+		else
+		{
+			// the address counter wraps around within the page
+			uint32_t offset = sim->addr % sim->pageSize;
+			sim->latch[offset] = frame;
+			if (!sim->latched[offset])
+			{
+				sim->latched[offset] = true;
+				sim->latchCount++;
+			}
+			sim->addr += ((offset + 1) % sim->pageSize) - offset;
+		}
+		break;
+
+	default:
+		break;
+	}
+	return retVal;
+}
+
+static void EEPROM_simDelayUs(EEPROM_Device* dev, uint32_t us)
+{
+	EEPROM_Sim* sim = dev->halCtx;
+	sim->timeNs += (uint64_t)us * 1000;
+}
+
+static uint32_t EEPROM_simHalTimeUs(EEPROM_Device* dev)
+{
+	return (uint32_t)EEPROM_simTimeUs(dev->halCtx);
+}
+
+static const EEPROM_Hal EEPROM_halSim =
+{
+	EEPROM_simExchange,
+	EEPROM_simSelect,
+	EEPROM_simDeselect,
+	EEPROM_simDelayUs,
+	EEPROM_simHalTimeUs,
+};
+
+void EEPROM_simInit(EEPROM_Sim* sim, EEPROM_Device* dev, EEPROM_Part part)
+{
+	memset(sim, 0, sizeof(*sim));
+	EEPROM_initDevice(dev, NULL, 0, 0, part);
+
+	sim->capacity = dev->capacity;
+	if (sim->capacity > EEPROM_SIM_MAX_CAPACITY)
+	{
+		sim->capacity = EEPROM_SIM_MAX_CAPACITY;
+	}
+	sim->pageSize = dev->pageSize;
+	sim->addressFormat = dev->addressFormat;
+	switch (sim->addressFormat)
+	{
+	case AddressFormat_OneByteA8:
+		sim->addressBytes = 1;
+		break;
+	case AddressFormat_ThreeByte:
+		sim->addressBytes = 3;
+		break;
+	case AddressFormat_TwoByte:
+	default:
+		sim->addressBytes = 2;
+		break;
+	}
+	memset(sim->memory, 0xFF, sizeof(sim->memory));
+
+	sim->sckHz = EEPROM_SIM_SCK_HZ;
+	sim->twcUs = EEPROM_SIM_TWC_US;
+	sim->csNs = EEPROM_SIM_CS_NS;
+
+	EEPROM_setHal(dev, &EEPROM_halSim, sim);
+}
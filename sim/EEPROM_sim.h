@@ -0,0 +1,125 @@
+/*
+ * EEPROM_sim.h
+ *
+ *  Host-side simulated 25xxx EEPROM with a timing model, connected to the driver
+ *  through the EEPROM_Hal of a device.
+ */
+
+#ifndef EEPROM_SIM_H_
+#define EEPROM_SIM_H_
+
+#include "EEPROM.h"
+
+/**
+ * @brief Largest memory array a simulated device can hold.
+ */
+#ifndef EEPROM_SIM_MAX_CAPACITY
+#define EEPROM_SIM_MAX_CAPACITY		4096
+#endif
+
+/**
+ * @brief Default SPI clock of a simulated device in Hz.
+ */
+#ifndef EEPROM_SIM_SCK_HZ
+#define EEPROM_SIM_SCK_HZ			10000000
+#endif
+
+/**
+ * @brief Default write cycle time of a simulated device in microseconds.
+ */
+#ifndef EEPROM_SIM_TWC_US
+#define EEPROM_SIM_TWC_US			5000
+#endif
+
+/**
+ * @brief Default chip select setup and hold time of a simulated device in nanoseconds.
+ */
+#ifndef EEPROM_SIM_CS_NS
+#define EEPROM_SIM_CS_NS			100
+#endif
+
+/**
+ * @brief Activity counters of a simulated device.
+ */
+typedef struct
+{
+	uint32_t busBytes;			/**< Frames exchanged while selected			*/
+	uint32_t transactions;		/**< Chip select framed transactions			*/
+	uint32_t statusPolls;		/**< Read Status Register transactions			*/
+	uint32_t writeCycles;		/**< Internal write cycles started				*/
+	uint32_t rejectedWrites;	/**< Writes dropped by WEN or block protection	*/
+}EEPROM_SimCounters;
+
+/**
+ * @brief State of a simulated device.
+ *
+ * Time only advances through the HAL: every frame takes 8 SCK periods, every chip
+ * select window adds @p csNs and every driver delay adds its duration. The WP pin
+ * is modelled as high, so WPEN is stored but never locks the status register.
+ */
+typedef struct
+{
+	uint8_t memory[EEPROM_SIM_MAX_CAPACITY];	/**< Memory array, erased to 0xFF	*/
+	uint32_t capacity;							/**< Size of the memory array		*/
+	uint16_t pageSize;							/**< Write page size				*/
+	EEPROM_AddressFormat addressFormat;			/**< Address bytes of the part		*/
+
+	uint8_t status;			/**< Non volatile BP and WPEN bits						*/
+	bool writeEnabled;		/**< Write enable latch									*/
+	uint64_t timeNs;		/**< Simulated time										*/
+	uint64_t busyUntilNs;	/**< End of the current write cycle						*/
+
+	uint32_t sckHz;			/**< SPI clock, defaults to EEPROM_SIM_SCK_HZ			*/
+	uint32_t twcUs;			/**< Write cycle time, defaults to EEPROM_SIM_TWC_US	*/
+	uint32_t csNs;			/**< Chip select overhead, defaults to EEPROM_SIM_CS_NS	*/
+
+	EEPROM_SimCounters counters;	/**< Activity counters							*/
+
+	// state of the current transaction
+	bool selected;
+	bool ignored;
+	uint32_t frame;
+	uint8_t opcode;
+	uint32_t addr;
+	uint32_t addressBytes;
+	uint8_t statusData;
+	uint8_t latch[EEPROM_MAX_PAGE_SIZE];
+	bool latched[EEPROM_MAX_PAGE_SIZE];
+	uint32_t latchCount;
+}EEPROM_Sim;
+
+/**
+ * @brief Initialize a simulated device and connect a device descriptor to it.
+ *
+ * The descriptor is initialized with @ref EEPROM_initDevice for the given part,
+ * without an SPI driver, and the simulated device takes its geometry. The memory
+ * array is erased to 0xFF, the status register is cleared and the time starts at 0.
+ * The timing fields can be changed afterwards.
+ *
+ * @param[out] sim Pointer to the simulated device.
+ * @param[out] dev Pointer to the EEPROM_Device structure to connect.
+ * @param[in] part EEPROM part to simulate.
+ *
+ * @return None.
+ */
+void EEPROM_simInit(EEPROM_Sim* sim, EEPROM_Device* dev, EEPROM_Part part);
+
+/**
+ * @brief Get the simulated time.
+ *
+ * @param[in] sim Pointer to the simulated device.
+ *
+ * @return Simulated time in microseconds.
+ */
+uint64_t EEPROM_simTimeUs(const EEPROM_Sim* sim);
+
+/**
+ * @brief Check whether a write cycle is in progress.
+ *
+ * @param[in] sim Pointer to the simulated device.
+ *
+ * @return true while the device is busy.
+ */
+bool EEPROM_simBusy(const EEPROM_Sim* sim);
+
+#endif /* EEPROM_SIM_H_ */
@@ -0,0 +1,28 @@
+/*
+ * components.h
+ *
+ *  Host build stand-in for the SPC5Studio components header, provides the
+ *  few definitions the EEPROM driver uses without the SPC5 HAL.
+ */
+
+#ifndef COMPONENTS_H_
+#define COMPONENTS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef FALSE
+#define FALSE	0
+#endif
+#ifndef TRUE
+#define TRUE	1
+#endif
+
+#ifndef EEPROM_USE_SPC5_HAL
+#define EEPROM_USE_SPC5_HAL		FALSE
+#endif
+
+typedef uint32_t ioportid_t;
+
+#endif /* COMPONENTS_H_ */
@@ -0,0 +1,19 @@
+/*
+ * spi_lld.h
+ *
+ *  Host build stand-in for the SPC5 low level SPI driver types.
+ */
+
+#ifndef SPI_LLD_H_
+#define SPI_LLD_H_
+
+#include "components.h"
+
+typedef struct SPIDriver SPIDriver;
+
+typedef struct
+{
+	void (*end_cb)(SPIDriver* spip);
+}SPIConfig;
+
+#endif /* SPI_LLD_H_ */
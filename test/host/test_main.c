@@ -0,0 +1,507 @@
+/**
+ * @file test_main.c
+ *
+ * @brief Host tests of the EEPROM driver and its modules against the simulated EEPROM.
+ *
+ * @details Every test starts from a freshly initialized simulated device. The HAL of
+ * the device is wrapped to inject faults after a write cycle has started: a byte of
+ * the written page can be flipped to fail the readback verification, and the power
+ * can be cut, which discards or tears the write cycle and drops all later writes.
+ * Prints one line per test and returns the number of failed checks.
+ */
+
+#include "EEPROM_sim.h"
+#include "EEPROM_log.h"
+#include "EEPROM_atomic.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_CHECK(cond)	testCheck((cond), #cond, __LINE__)
+
+static EEPROM_Sim sim;
+static EEPROM_Device dev;
+static EEPROM_Part simPart;
+static const EEPROM_Hal* simHal;
+static EEPROM_Hal faultHal;
+
+static uint8_t before[EEPROM_SIM_MAX_CAPACITY];	// memory array at the last select
+static uint32_t cyclesSeen;
+static uint32_t flipAddr;		// byte flipped after a write cycle of its page
+static uint32_t flipCount;		// write cycles of that page still to fail
+static int32_t cutBudget;		// write cycles before the power cut, -1 for none
+static bool tearCut;			// the cut write cycle keeps half of its bytes
+static bool powerLost;
+
+static uint32_t failures;
+static uint32_t testFailures;
+
+static void testCheck(bool cond, const char* text, int line)
+{
+	if (!cond)
+	{
+		printf("  line %d: %s\n", line, text);
+		failures++;
+		testFailures++;
+	}
+}
+
+//---------------------------------------Fault Injection---------------------------------------
+static void faultSelect(EEPROM_Device* d)
+{
+	memcpy(before, sim.memory, sim.capacity);
+	simHal->select(d);
+}
+
+/**
+ * @brief Apply the faults to a write cycle started by the transaction just ended.
+ */
+static void faultDeselect(EEPROM_Device* d)
+{
+	simHal->deselect(d);
+	if (sim.counters.writeCycles == cyclesSeen)
+	{
+		return;
+	}
+	cyclesSeen = sim.counters.writeCycles;
+
+	if (cutBudget == 0)
+	{
+		// the first half of the changed bytes made it before the power was lost
+		uint32_t changed = 0;
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < sim.capacity; i++)
+		{
+			changed += (sim.memory[i] != before[i]) ? 1 : 0;
+		}
+		for (uint32_t i = 0; i < sim.capacity; i++)
+		{
+			if (sim.memory[i] != before[i])
+			{
+				if (!tearCut || (kept >= changed / 2))
+				{
+					sim.memory[i] = before[i];
+				}
+				kept++;
+			}
+		}
+		// from now on every write is dropped
+		sim.status |= EEPROM_STATUS_BIT_BP;
+		cutBudget = -1;
+		powerLost = true;
+		return;
+	}
+	if (cutBudget > 0)
+	{
+		cutBudget--;
+	}
+
+	if ((flipCount > 0) && (sim.memory[flipAddr] != before[flipAddr]))
+	{
+		flipCount--;
+		sim.memory[flipAddr] ^= 0x10;
+	}
+}
+
+static void installFaults(void)
+{
+	simHal = dev.hal;
+	faultHal = *simHal;
+	faultHal.select = faultSelect;
+	faultHal.deselect = faultDeselect;
+	EEPROM_setHal(&dev, &faultHal, &sim);
+
+	cyclesSeen = sim.counters.writeCycles;
+	flipCount = 0;
+	cutBudget = -1;
+	tearCut = false;
+	powerLost = false;
+}
+
+static void startDevice(EEPROM_Part part)
+{
+	simPart = part;
+	EEPROM_simInit(&sim, &dev, part);
+	installFaults();
+}
+
+/**
+ * @brief Restart the device and the driver, keeping only the memory array.
+ */
+static void powerCycle(void)
+{
+	static uint8_t memory[EEPROM_SIM_MAX_CAPACITY];
+
+	memcpy(memory, sim.memory, sizeof(memory));
+	EEPROM_simInit(&sim, &dev, simPart);
+	memcpy(sim.memory, memory, sizeof(memory));
+	installFaults();
+}
+
+static void fill(uint8_t* buf, uint32_t length, uint8_t seed)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		buf[i] = (uint8_t)(seed + i);
+	}
+}
+
+static bool isErased(uint32_t addr, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		if (sim.memory[addr + i] != 0xFF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-------------------------------------------Tests-------------------------------------------
+static void testPageSplit(void)
+{
+	uint8_t data[100];
+	uint8_t read[100];
+	uint32_t cycles;
+
+	// bytes 40 to 139 touch the pages at 32, 64, 96 and 128
+	startDevice(Part_AT25320A);
+	fill(data, sizeof(data), 1);
+	cycles = sim.counters.writeCycles;
+	TEST_CHECK(EEPROM_writeRange(&dev, 40, data, sizeof(data)) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(sim.counters.writeCycles - cycles == 4);
+	TEST_CHECK(memcmp(&sim.memory[40], data, sizeof(data)) == 0);
+	TEST_CHECK(isErased(0, 40) && isErased(140, 32));
+	EEPROM_readRange(&dev, 40, read, sizeof(read));
+	TEST_CHECK(memcmp(read, data, sizeof(data)) == 0);
+
+	// a write within one page takes one cycle, also when it ends on the boundary
+	cycles = sim.counters.writeCycles;
+	TEST_CHECK(EEPROM_writeRange(&dev, 200, data, 24) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(sim.counters.writeCycles - cycles == 1);
+	TEST_CHECK(memcmp(&sim.memory[200], data, 24) == 0);
+
+	// 16 byte pages: bytes 12 to 31 touch the pages at 0 and 16
+	startDevice(Part_M95040);
+	cycles = sim.counters.writeCycles;
+	TEST_CHECK(EEPROM_writeRange(&dev, 12, data, 20) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(sim.counters.writeCycles - cycles == 2);
+	TEST_CHECK(memcmp(&sim.memory[12], data, 20) == 0);
+	TEST_CHECK(isErased(0, 12) && isErased(32, 16));
+}
+
+static void testM95040Addressing(void)
+{
+	uint8_t data[32];
+	uint8_t read[32];
+
+	startDevice(Part_M95040);
+	fill(data, sizeof(data), 0x40);
+
+	// the ninth address bit is sent in the instruction
+	TEST_CHECK(EEPROM_writeRange(&dev, 0x100, data, 16) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(memcmp(&sim.memory[0x100], data, 16) == 0);
+	TEST_CHECK(isErased(0x000, 16));
+
+	// a range across the A8 boundary is split into pages on both sides
+	TEST_CHECK(EEPROM_writeRange(&dev, 0xF0, data, sizeof(data)) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(memcmp(&sim.memory[0xF0], data, sizeof(data)) == 0);
+	TEST_CHECK(isErased(0x1F0, 16));
+	EEPROM_readRange(&dev, 0xF0, read, sizeof(read));
+	TEST_CHECK(memcmp(read, data, sizeof(data)) == 0);
+
+	EEPROM_writeByte(&dev, 0x1FF, 0xA5);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(sim.memory[0x1FF] == 0xA5);
+	TEST_CHECK(sim.memory[0x0FF] != 0xA5);
+	TEST_CHECK(EEPROM_readByte(&dev, 0x1FF) == 0xA5);
+}
+
+static void testProtection(void)
+{
+	uint8_t data[16];
+	uint32_t quarter;
+	uint32_t transactions;
+
+	startDevice(Part_AT25320A);
+	quarter = dev.capacity - dev.capacity / 4;
+	fill(data, sizeof(data), 0x80);
+
+	TEST_CHECK(EEPROM_writeStatusReg(&dev, BlockProtection_Quarter << 2) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK((sim.status & EEPROM_STATUS_BIT_BP) == (BlockProtection_Quarter << 2));
+
+	// rejected by the driver, without a transfer
+	transactions = sim.counters.transactions;
+	TEST_CHECK(EEPROM_writeRange(&dev, quarter, data, sizeof(data)) == Result_Protected);
+	TEST_CHECK(EEPROM_writeRange(&dev, quarter - 8, data, sizeof(data)) == Result_Protected);
+	EEPROM_writeByte(&dev, dev.capacity - 1, 0x00);
+	TEST_CHECK(sim.counters.transactions == transactions);
+	TEST_CHECK(isErased(quarter - 8, dev.capacity - quarter + 8));
+
+	TEST_CHECK(EEPROM_writeRange(&dev, quarter - 16, data, sizeof(data)) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(memcmp(&sim.memory[quarter - 16], data, sizeof(data)) == 0);
+
+	TEST_CHECK(EEPROM_writeStatusReg(&dev, BlockProtection_None << 2) == Result_Ok);
+	TEST_CHECK(EEPROM_writeRange(&dev, quarter, data, sizeof(data)) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(memcmp(&sim.memory[quarter], data, sizeof(data)) == 0);
+}
+
+static void testBusyAtStart(void)
+{
+	uint8_t data[4] = {1, 2, 3, 4};
+
+	// a write cycle the driver did not start, the block protection is unknown
+	startDevice(Part_AT25320A);
+	sim.busyUntilNs = sim.timeNs + 3000000;
+	EEPROM_writeByte(&dev, 10, 0x5A);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(sim.memory[10] == 0x5A);
+
+	startDevice(Part_AT25320A);
+	sim.busyUntilNs = sim.timeNs + 3000000;
+	TEST_CHECK(EEPROM_writeRange(&dev, 40, data, sizeof(data)) == Result_Ok);
+	TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+	TEST_CHECK(memcmp(&sim.memory[40], data, sizeof(data)) == 0);
+}
+
+static void testVerify(void)
+{
+	uint8_t data[100];
+	uint32_t cycles;
+
+	for (uint32_t mode = VerifyMode_Compare; mode <= VerifyMode_Crc; mode++)
+	{
+		startDevice(Part_AT25320A);
+		EEPROM_setVerify(&dev, (EEPROM_VerifyMode)mode, 2);
+		fill(data, sizeof(data), (uint8_t)mode);
+
+		// one failed readback of the page at 64 is written again
+		flipAddr = 70;
+		flipCount = 1;
+		cycles = sim.counters.writeCycles;
+		TEST_CHECK(EEPROM_writeRange(&dev, 40, data, sizeof(data)) == Result_Ok);
+		TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+		TEST_CHECK(sim.counters.writeCycles - cycles == 5);
+		TEST_CHECK(memcmp(&sim.memory[40], data, sizeof(data)) == 0);
+
+		// the last page is verified by the wait
+		fill(data, sizeof(data), (uint8_t)(mode + 0x20));
+		flipAddr = 135;
+		flipCount = 1;
+		cycles = sim.counters.writeCycles;
+		TEST_CHECK(EEPROM_writeRange(&dev, 40, data, sizeof(data)) == Result_Ok);
+		TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+		TEST_CHECK(sim.counters.writeCycles - cycles == 5);
+		TEST_CHECK(memcmp(&sim.memory[40], data, sizeof(data)) == 0);
+
+		// the first write and both retries fail, the later pages are not written
+		fill(data, sizeof(data), (uint8_t)(mode + 0x40));
+		flipAddr = 50;
+		flipCount = 3;
+		cycles = sim.counters.writeCycles;
+		TEST_CHECK(EEPROM_writeRange(&dev, 40, data, sizeof(data)) == Result_VerifyError);
+		TEST_CHECK(sim.counters.writeCycles - cycles == 3);
+		TEST_CHECK(sim.memory[64] != data[24]);
+		TEST_CHECK(EEPROM_wait(&dev) == Result_Ok);
+
+		// exhausted on the last page, reported by the wait
+		flipAddr = 135;
+		flipCount = 3;
+		TEST_CHECK(EEPROM_writeRange(&dev, 40, data, sizeof(data)) == Result_Ok);
+		TEST_CHECK(EEPROM_wait(&dev) == Result_VerifyError);
+	}
+}
+
+static void logRecord(uint8_t* record, uint32_t index)
+{
+	memset(record, (uint8_t)index, 16);
+}
+
+/**
+ * @brief Check that every readable slot holds the records of its sequence number.
+ *
+ * @return Number of readable slots.
+ */
+static uint32_t checkLog(EEPROM_Log* log)
+{
+	uint8_t records[3 * 16];
+	uint8_t expected[16];
+	uint32_t valid = 0;
+
+	for (uint32_t back = 0; back < log->used; back++)
+	{
+		uint32_t seq = log->nextSeq - 1 - back;
+		uint16_t count = EEPROM_logReadSlot(log, back, records);
+		if (count == 0)
+		{
+			continue;
+		}
+		TEST_CHECK(count == 3);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			logRecord(expected, seq * 3 + i);
+			TEST_CHECK(memcmp(&records[i * 16], expected, 16) == 0);
+		}
+		valid++;
+	}
+	return valid;
+}
+
+static void testLogTornSync(void)
+{
+	static uint8_t start[EEPROM_SIM_MAX_CAPACITY];
+	static EEPROM_Log log;
+	uint8_t record[16];
+	bool complete;
+
+	// 4 slots of 2 pages with 3 records each, 5 slots written so the ring wrapped
+	startDevice(Part_AT25320A);
+	TEST_CHECK(EEPROM_logInit(&log, &dev, 0, 4, 2, 16));
+	TEST_CHECK(log.recordsPerSlot == 3);
+	EEPROM_logMount(&log);
+	for (uint32_t i = 0; i < 15; i++)
+	{
+		logRecord(record, i);
+		TEST_CHECK(EEPROM_logAppend(&log, record) == Result_Ok);
+	}
+	memcpy(start, sim.memory, sizeof(start));
+
+	for (uint32_t tear = 0; tear < 2; tear++)
+	{
+		for (int32_t budget = 0; budget <= 4; budget++)
+		{
+			memcpy(sim.memory, start, sizeof(start));
+			powerCycle();
+			EEPROM_logInit(&log, &dev, 0, 4, 2, 16);
+			EEPROM_logMount(&log);
+			TEST_CHECK(log.nextSeq == 5);
+
+			// the sixth batch overwrites the slot of the first one
+			cutBudget = budget;
+			tearCut = (tear != 0);
+			for (uint32_t i = 15; i < 18; i++)
+			{
+				logRecord(record, i);
+				EEPROM_logAppend(&log, record);
+			}
+			complete = !powerLost;
+
+			powerCycle();
+			EEPROM_logInit(&log, &dev, 0, 4, 2, 16);
+			EEPROM_logMount(&log);
+			TEST_CHECK(log.used == 4);
+			if (complete)
+			{
+				TEST_CHECK(log.nextSeq == 6);
+				TEST_CHECK(checkLog(&log) == 4);
+			}
+			else
+			{
+				// the slot being written is lost or still holds the first batch, the
+				// three after it are intact
+				TEST_CHECK(log.nextSeq == 5);
+				TEST_CHECK(checkLog(&log) >= 3);
+			}
+		}
+	}
+}
+
+static void testAtomicTornCommit(void)
+{
+	static uint8_t start[EEPROM_SIM_MAX_CAPACITY];
+	static EEPROM_Atomic rec;
+	uint8_t data[40];
+	uint8_t read[40];
+	uint16_t length;
+	uint32_t cycles;
+	bool complete;
+
+	// each copy is a header page and two data pages
+	startDevice(Part_AT25320A);
+	TEST_CHECK(EEPROM_atomicInit(&rec, &dev, 0, sizeof(data)));
+	EEPROM_atomicMount(&rec);
+	memset(data, 0x11, sizeof(data));
+	TEST_CHECK(EEPROM_atomicCommit(&rec, data, 40) == Result_Ok);
+	memset(data, 0x22, sizeof(data));
+	TEST_CHECK(EEPROM_atomicCommit(&rec, data, 30) == Result_Ok);
+	memcpy(start, sim.memory, sizeof(start));
+
+	for (uint32_t tear = 0; tear < 2; tear++)
+	{
+		for (int32_t budget = 0; budget <= 3; budget++)
+		{
+			memcpy(sim.memory, start, sizeof(start));
+			powerCycle();
+			EEPROM_atomicInit(&rec, &dev, 0, sizeof(data));
+			TEST_CHECK(EEPROM_atomicMount(&rec));
+
+			cutBudget = budget;
+			tearCut = (tear != 0);
+			memset(data, 0x33, sizeof(data));
+			EEPROM_atomicCommit(&rec, data, 35);
+			complete = !powerLost;
+
+			// either the previous or the new data, never a mix
+			powerCycle();
+			EEPROM_atomicInit(&rec, &dev, 0, sizeof(data));
+			TEST_CHECK(EEPROM_atomicMount(&rec));
+			TEST_CHECK(EEPROM_atomicRead(&rec, read, &length) == Result_Ok);
+			if (complete)
+			{
+				TEST_CHECK((length == 35) && (read[0] == 0x33) && (read[34] == 0x33));
+			}
+			else
+			{
+				uint8_t value = (length == 35) ? 0x33 : 0x22;
+				TEST_CHECK((length == 30) || (length == 35));
+				for (uint32_t i = 0; i < length; i++)
+				{
+					TEST_CHECK(read[i] == value);
+				}
+			}
+		}
+	}
+
+	// a commit longer than the record is rejected without a write
+	cycles = sim.counters.writeCycles;
+	TEST_CHECK(EEPROM_atomicCommit(&rec, data, sizeof(data) + 1) == Result_OutOfRange);
+	TEST_CHECK(sim.counters.writeCycles == cycles);
+}
+
+//-------------------------------------------Runner-------------------------------------------
+typedef struct
+{
+	const char* name;
+	void (*run)(void);
+}TestCase;
+
+static const TestCase tests[] =
+{
+	{"page_split",			testPageSplit},
+	{"m95040_addressing",	testM95040Addressing},
+	{"protection",			testProtection},
+	{"busy_at_start",		testBusyAtStart},
+	{"verify",				testVerify},
+	{"log_torn_sync",		testLogTornSync},
+	{"atomic_torn_commit",	testAtomicTornCommit},
+};
+
+int main(void)
+{
+	for (uint32_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+	{
+		testFailures = 0;
+		tests[i].run();
+		printf("%s: %s\n", tests[i].name, (testFailures == 0) ? "ok" : "FAIL");
+	}
+	printf("%u failed checks\n", failures);
+	return (failures == 0) ? 0 : 1;
+}